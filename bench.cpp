@@ -0,0 +1,532 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+// standard library
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+// event
+#include "event.hpp"
+#include "event_hierarchy.hpp"
+#include "event_noexcept.hpp"
+#include "event_route.hpp"
+#include "event_sharded.hpp"
+
+static void bench_startup_wiring();
+static void bench_bubbling();
+static void bench_fire_context();
+static void bench_exception_policies();
+static void bench_routing();
+static void bench_subrate();
+static void bench_contention();
+
+/*
+    This program measures the performance of the Event.
+*/
+int main(int argc, const char* argv[])
+{
+    bench_startup_wiring();
+    bench_bubbling();
+    bench_fire_context();
+    bench_exception_policies();
+    bench_routing();
+    bench_subrate();
+    bench_contention();
+    return EXIT_SUCCESS;
+}
+
+/*
+    Prints the time taken since start.
+*/
+static void report(
+    const char* name,
+    std::chrono::steady_clock::time_point start
+)
+{
+    auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start
+    );
+    std::printf("%-40s %10.2f ms\n", name, elapsed.count());
+}
+
+/*
+    Wiring 2M handlers across 1000 Events, as done at process start.
+*/
+static void bench_startup_wiring()
+{
+    const std::size_t event_count = 1000;
+    const std::size_t handlers_per_event = 2000;
+    int counter = 0;
+    std::function<void(int)> function = [&counter](int value){
+        counter += value;
+    };
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Event<int>> events(event_count);
+        std::vector<std::shared_ptr<Event<int>::Bind>> binds;
+        binds.reserve(event_count * handlers_per_event);
+        for (auto& event: events)
+        {
+            for (std::size_t i = 0; i < handlers_per_event; ++i)
+            {
+                binds.push_back(event.bind(function));
+            }
+        }
+        report("startup wiring: bind", start);
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Event<int>> events(event_count);
+        std::vector<std::function<void(int)>> functions(
+            handlers_per_event,
+            function
+        );
+        std::vector<Event<int>::BindGroup> groups;
+        groups.reserve(event_count);
+        for (auto& event: events)
+        {
+            groups.push_back(event.bind_many(functions));
+        }
+        report("startup wiring: bind_many", start);
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Event<int>> events(event_count);
+        for (auto& event: events)
+        {
+            event.reserve(handlers_per_event);
+            for (std::size_t i = 0; i < handlers_per_event; ++i)
+            {
+                event.permanent_bind(function);
+            }
+        }
+        report("startup wiring: reserve + permanent_bind", start);
+    }
+}
+
+/*
+    Firing at the leaf of a 64 deep tree with a function bound to every node,
+    compared to firing an Event per level.
+*/
+static void bench_bubbling()
+{
+    const std::size_t depth = 64;
+    const std::size_t fire_count = 200000;
+    int counter = 0;
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Event<int>> levels(depth);
+        for (auto& level: levels)
+        {
+            level.permanent_bind([&counter](int value){
+                counter += value;
+            });
+        }
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            for (auto level = levels.rbegin(); level != levels.rend(); ++level)
+            {
+                level->fire(1);
+            }
+        }
+        report("bubbling: Event per level", start);
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        typedef EventHierarchy<int> Hierarchy;
+        Hierarchy hierarchy;
+        std::vector<std::unique_ptr<Hierarchy::Node>> nodes;
+        std::vector<std::shared_ptr<Hierarchy::Bind>> binds;
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            nodes.emplace_back(new Hierarchy::Node(
+                hierarchy,
+                nodes.empty() ? 0 : nodes.back().get()
+            ));
+            binds.push_back(nodes.back()->bind(
+                [&counter](Hierarchy::Dispatch&, int value){
+                    counter += value;
+                }
+            ));
+        }
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            hierarchy.fire_bubbling(*nodes.back(), 1);
+        }
+        report("bubbling: fire_bubbling", start);
+    }
+    
+    if (counter != int(2 * depth * fire_count))
+    {
+        std::printf("bubbling: unexpected count\n");
+    }
+}
+
+/*
+    The cost of checking a FireContext between functions, firing an Event
+    with 1000 functions bound.
+*/
+static void bench_fire_context()
+{
+    const std::size_t handler_count = 1000;
+    const std::size_t fire_count = 20000;
+    int counter = 0;
+    Event<int> event;
+    for (std::size_t i = 0; i < handler_count; ++i)
+    {
+        event.permanent_bind([&counter](int value){
+            counter += value;
+        });
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            event.fire(1);
+        }
+        report("fire context: fire", start);
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        FireContext context;
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            event.fire(context, 1);
+        }
+        report("fire context: fire with context", start);
+    }
+    
+    if (counter != int(2 * handler_count * fire_count))
+    {
+        std::printf("fire context: unexpected count\n");
+    }
+}
+
+/*
+    Firing 1000 handlers with each exception policy: a plain fire, an
+    isolated fire that collects exceptions and a NoexceptEvent, whose loop
+    cannot unwind.
+*/
+static void bench_exception_policies()
+{
+    const std::size_t handler_count = 1000;
+    const std::size_t fire_count = 20000;
+    int counter = 0;
+    Event<int> event;
+    NoexceptEvent<int> noexcept_event;
+    std::vector<std::shared_ptr<NoexceptEvent<int>::Bind>> binds;
+    for (std::size_t i = 0; i < handler_count; ++i)
+    {
+        event.permanent_bind([&counter](int value){
+            counter += value;
+        });
+        binds.push_back(noexcept_event.bind([&counter](int value) noexcept {
+            counter += value;
+        }));
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            event.fire(1);
+        }
+        report("exception policies: fire", start);
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            event.fire_isolated(1);
+        }
+        report("exception policies: fire_isolated", start);
+    }
+    
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < fire_count; ++i)
+        {
+            noexcept_event.fire(1);
+        }
+        report("exception policies: NoexceptEvent", start);
+    }
+    
+    if (counter != int(3 * handler_count * fire_count))
+    {
+        std::printf("exception policies: unexpected count\n");
+    }
+}
+
+/*
+    1000 subscribers that each want the orders of one account, filtering in
+    every bound function compared to a RoutedEvent.
+*/
+static void bench_routing()
+{
+    struct Order
+    {
+        int account;
+        int quantity;
+    };
+    const int subscriber_count = 1000;
+    const int fire_count = 100000;
+    int counter = 0;
+    
+    {
+        Event<const Order&> event;
+        for (int i = 0; i < subscriber_count; ++i)
+        {
+            event.permanent_bind([&counter, i](const Order& order){
+                if (order.account == i && order.quantity > 100)
+                {
+                    counter += 1;
+                }
+            });
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < fire_count; ++i)
+        {
+            event.fire(Order{i % subscriber_count, i % 200});
+        }
+        report("routing: filter in each function", start);
+    }
+    
+    {
+        RoutedEvent<Order> event;
+        auto account = event.field(&Order::account);
+        auto quantity = event.field(&Order::quantity);
+        std::vector<std::shared_ptr<RoutedEvent<Order>::Bind>> binds;
+        for (int i = 0; i < subscriber_count; ++i)
+        {
+            binds.push_back(event.bind(
+                account == i && quantity > 100,
+                [&counter](const Order&){
+                    counter += 1;
+                }
+            ));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < fire_count; ++i)
+        {
+            event.fire(Order{i % subscriber_count, i % 200});
+        }
+        report("routing: RoutedEvent", start);
+    }
+    
+    if (counter != 2 * (fire_count / 200) * 99)
+    {
+        std::printf("routing: unexpected count\n");
+    }
+}
+
+/*
+    100 telemetry handlers that only want 1 in 100 firings, returning early
+    from the other firings compared to bind_decimated and bind_sampled.
+*/
+static void bench_subrate()
+{
+    const int handler_count = 100;
+    const int fire_count = 1000000;
+    int counter = 0;
+    
+    {
+        Event<int> event;
+        for (int i = 0; i < handler_count; ++i)
+        {
+            event.permanent_bind([&counter](int value){
+                if (value % 100 != 0)
+                {
+                    return;
+                }
+                counter += 1;
+            });
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < fire_count; ++i)
+        {
+            event.fire(i);
+        }
+        report("subrate: return early", start);
+    }
+    
+    {
+        Event<int> event;
+        std::vector<std::shared_ptr<Event<int>::Bind>> binds;
+        for (int i = 0; i < handler_count; ++i)
+        {
+            binds.push_back(event.bind_decimated(100, [&counter](int){
+                counter += 1;
+            }));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < fire_count; ++i)
+        {
+            event.fire(i);
+        }
+        report("subrate: bind_decimated", start);
+    }
+    
+    {
+        Event<int> event;
+        std::vector<std::shared_ptr<Event<int>::Bind>> binds;
+        for (int i = 0; i < handler_count; ++i)
+        {
+            binds.push_back(event.bind_sampled(0.01, [&counter](int){
+                counter += 1;
+            }));
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < fire_count; ++i)
+        {
+            event.fire(i);
+        }
+        report("subrate: bind_sampled", start);
+    }
+    
+    if (counter < 2 * handler_count * (fire_count / 100))
+    {
+        std::printf("subrate: unexpected count\n");
+    }
+}
+
+/*
+    Runs bind_unbind on thread_count threads while another thread fires,
+    returning once every thread has made operation_count binds in total.
+*/
+template <typename BindUnbind, typename Fire>
+static void contend(
+    std::size_t thread_count,
+    std::size_t operation_count,
+    BindUnbind bind_unbind,
+    Fire fire
+)
+{
+    std::atomic<bool> running(true);
+    std::thread firing([&]{
+        while (running)
+        {
+            fire();
+        }
+    });
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back([&]{
+            for (std::size_t j = 0; j < operation_count / thread_count; ++j)
+            {
+                bind_unbind();
+            }
+        });
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    running = false;
+    firing.join();
+}
+
+/*
+    Binding and unbinding from 1 to 128 threads while another thread fires,
+    comparing an Event behind a single lock with a ShardedEvent.
+*/
+static void bench_contention()
+{
+    const std::size_t operation_count = 256000;
+    std::atomic<int> counter(0);
+    auto function = [&counter](int value){
+        counter += value;
+    };
+    char name[64];
+    
+    for (std::size_t threads = 1; threads <= 128; threads *= 2)
+    {
+        {
+            std::mutex mutex;
+            Event<int> event;
+            auto start = std::chrono::steady_clock::now();
+            contend(
+                threads,
+                operation_count,
+                [&]{
+                    std::shared_ptr<Event<int>::Bind> bind;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        bind = event.bind(function);
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    bind = 0;
+                },
+                [&]{
+                    std::lock_guard<std::mutex> lock(mutex);
+                    event.fire(1);
+                }
+            );
+            std::snprintf(
+                name,
+                sizeof(name),
+                "contention: locked Event %3zu",
+                threads
+            );
+            report(name, start);
+        }
+        {
+            ShardedEvent<int> event;
+            auto start = std::chrono::steady_clock::now();
+            contend(
+                threads,
+                operation_count,
+                [&]{
+                    auto bind = event.bind(function);
+                },
+                [&]{
+                    event.fire(1);
+                }
+            );
+            std::snprintf(
+                name,
+                sizeof(name),
+                "contention: ShardedEvent %3zu",
+                threads
+            );
+            report(name, start);
+        }
+    }
+}
@@ -28,10 +28,574 @@ THE SOFTWARE.
 #define EVENT_HPP
 
 // standard library
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <functional>
-#include <list>
+#include <iterator>
 #include <memory>
-#include <set>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 202002L
+#include <stop_token>
+#endif
+
+class Trackable;
+
+template <typename... Args>
+class EventSender;
+
+template <typename Receiver, typename... Args>
+class EventOperation;
+
+template <typename... Args>
+class EventFuture;
+
+namespace event_detail
+{
+    /*
+        IndexSequence
+
+        A compile time list of indices, used to expand a tuple back into an
+        argument list (std::index_sequence is not available in C++11).
+    */
+    template <std::size_t... Indices>
+    struct IndexSequence
+    {
+    };
+
+    template <std::size_t N, std::size_t... Indices>
+    struct MakeIndexSequence:
+        MakeIndexSequence<N - 1, N - 1, Indices...>
+    {
+    };
+
+    template <std::size_t... Indices>
+    struct MakeIndexSequence<0, Indices...>
+    {
+        typedef IndexSequence<Indices...> Type;
+    };
+
+    /*
+        And
+
+        Compile time conjunction of a list of booleans, true for an empty
+        list.
+    */
+    template <bool... Values>
+    struct And: std::true_type
+    {
+    };
+
+    template <bool... Values>
+    struct And<false, Values...>: std::false_type
+    {
+    };
+
+    template <bool... Values>
+    struct And<true, Values...>: And<Values...>
+    {
+    };
+
+    template <typename T>
+    struct IsTuple: std::false_type
+    {
+    };
+
+    template <typename... Types>
+    struct IsTuple<std::tuple<Types...>>: std::true_type
+    {
+    };
+
+    /*
+        NeverStop
+
+        The stop condition of a plain firing, which the compiler removes
+        entirely.
+    */
+    struct NeverStop
+    {
+        bool operator()() const
+        {
+            return false;
+        }
+    };
+
+    /*
+        CallDirectly
+
+        Calls bound functions for a plain firing, exceptions propagate out of
+        the firing.
+    */
+    struct CallDirectly
+    {
+        template <typename Function, typename... Values>
+        void operator()(Function& function, Values&... values) const
+        {
+            function(values...);
+        }
+    };
+
+    /*
+        CallIsolated
+
+        Calls bound functions for Event::fire_isolated, collecting their
+        exceptions instead of letting them end the firing. Room for an
+        exception from every function is made at the first one.
+    */
+    class CallIsolated
+    {
+        public:
+
+            explicit CallIsolated(std::size_t capacity):
+                capacity(capacity)
+            {
+            }
+
+            template <typename Function, typename... Values>
+            void operator()(Function& function, Values&... values)
+            {
+                try
+                {
+                    function(values...);
+                }
+                catch (...)
+                {
+                    if (this->errors.empty())
+                    {
+                        this->errors.reserve(this->capacity);
+                    }
+                    this->errors.push_back(std::current_exception());
+                }
+            }
+
+            std::size_t capacity;
+
+            std::vector<std::exception_ptr> errors;
+    };
+
+    /*
+        Something waiting for the next firing of an Event, see EventOperation.
+        Waiters are threaded into an intrusive list owned by the Event, so
+        waiting never allocates.
+    */
+    template <typename... Args>
+    class EventWaiter
+    {
+        public:
+
+            EventWaiter():
+                list(0),
+                previous(0),
+                next(0)
+            {
+            }
+
+            // Called with the arguments of the firing, after being removed
+            // from the list. Must not throw.
+            virtual void complete(Args&... args) = 0;
+
+            // Called, after being removed from the list, when the Event is
+            // destroyed without having fired.
+            virtual void stop() = 0;
+
+            // True once nothing is interested in the result any more, the
+            // Event then drops the waiter through stop rather than counting
+            // it as a handler.
+            virtual bool is_abandoned() const
+            {
+                return false;
+            }
+
+            bool is_waiting() const
+            {
+                return this->list != 0;
+            }
+
+            void link(EventWaiter*& list)
+            {
+                assert(!this->list);
+                this->list = &list;
+                this->previous = 0;
+                this->next = list;
+                if (this->next)
+                {
+                    this->next->previous = this;
+                }
+                list = this;
+            }
+
+            void unlink()
+            {
+                if (!this->list)
+                {
+                    return;
+                }
+                if (this->previous)
+                {
+                    this->previous->next = this->next;
+                }
+                else
+                {
+                    *this->list = this->next;
+                }
+                if (this->next)
+                {
+                    this->next->previous = this->previous;
+                }
+                this->list = 0;
+                this->previous = 0;
+                this->next = 0;
+            }
+
+            // Takes the place of other in its list.
+            void replace(EventWaiter& other)
+            {
+                assert(!this->list);
+                if (!other.list)
+                {
+                    return;
+                }
+                this->list = other.list;
+                this->previous = other.previous;
+                this->next = other.next;
+                if (this->previous)
+                {
+                    this->previous->next = this;
+                }
+                else
+                {
+                    *this->list = this;
+                }
+                if (this->next)
+                {
+                    this->next->previous = this;
+                }
+                other.list = 0;
+                other.previous = 0;
+                other.next = 0;
+            }
+
+        protected:
+
+            ~EventWaiter()
+            {
+            }
+
+        private:
+
+            EventWaiter(const EventWaiter&) = delete;
+
+            EventWaiter& operator=(const EventWaiter&) = delete;
+
+            EventWaiter** list;
+
+            EventWaiter* previous;
+
+            EventWaiter* next;
+    };
+
+    /*
+        A bind made on behalf of a Trackable. TrackedConnections are threaded
+        into an intrusive list owned by the Trackable so that it can disconnect
+        all of them when it is destroyed.
+    */
+    class TrackedConnection
+    {
+        public:
+        
+            /*
+                disconnect
+                
+                Unbinds the connection, which also stops it being tracked.
+            =================================================================*/
+            virtual void disconnect() = 0;
+            
+        protected:
+        
+            TrackedConnection():
+                trackable(0),
+                tracked_previous(0),
+                tracked_next(0)
+            {
+            }
+            
+            ~TrackedConnection()
+            {
+            }
+            
+            void track(Trackable& trackable);
+            
+            void untrack();
+            
+        private:
+        
+            friend class ::Trackable;
+            
+            Trackable* trackable;
+            
+            TrackedConnection* tracked_previous;
+            
+            TrackedConnection* tracked_next;
+    };
+}
+
+/*
+    A base class for objects that bind to Events. Functions bound on behalf of
+    a Trackable (see Event::bind(owner, function)) are unbound when it is
+    destroyed, without the object having to hold on to a Bind for each one.
+*/
+class Trackable
+{
+    public:
+    
+        /*
+            Constructor
+        =====================================================================*/
+        Trackable():
+            connections(0)
+        {
+        }
+        
+        /*
+            Copy Constructor
+            
+            Binds belong to the object they were made for, so a copy starts
+            with none.
+        =====================================================================*/
+        Trackable(const Trackable&):
+            connections(0)
+        {
+        }
+        
+        /*
+            Destructor
+        =====================================================================*/
+        ~Trackable()
+        {
+            this->disconnect_all();
+        }
+        
+        Trackable& operator=(const Trackable&)
+        {
+            return *this;
+        }
+        
+        /*
+            disconnect_all
+            
+            Unbinds every function bound on behalf of the object.
+        =====================================================================*/
+        void disconnect_all()
+        {
+            while (this->connections)
+            {
+                this->connections->disconnect();
+            }
+        }
+        
+    private:
+    
+        friend class event_detail::TrackedConnection;
+        
+        event_detail::TrackedConnection* connections;
+};
+
+inline void event_detail::TrackedConnection::track(Trackable& trackable)
+{
+    assert(!this->trackable);
+    this->trackable = &trackable;
+    this->tracked_next = trackable.connections;
+    if (this->tracked_next)
+    {
+        this->tracked_next->tracked_previous = this;
+    }
+    trackable.connections = this;
+}
+
+inline void event_detail::TrackedConnection::untrack()
+{
+    if (!this->trackable)
+    {
+        return;
+    }
+    if (this->tracked_previous)
+    {
+        this->tracked_previous->tracked_next = this->tracked_next;
+    }
+    else
+    {
+        this->trackable->connections = this->tracked_next;
+    }
+    if (this->tracked_next)
+    {
+        this->tracked_next->tracked_previous = this->tracked_previous;
+    }
+    this->trackable = 0;
+    this->tracked_previous = 0;
+    this->tracked_next = 0;
+}
+
+/*
+    Thrown by Event::fire_isolated once every bound function has executed if
+    any of them threw, holding each exception in the order they were thrown.
+*/
+class EventErrors: public std::runtime_error
+{
+    public:
+    
+        /*
+            Constructor
+        =====================================================================*/
+        explicit EventErrors(std::vector<std::exception_ptr> errors):
+            std::runtime_error(
+                std::to_string(errors.size()) +
+                " bound functions threw while firing"
+            ),
+            errors_(std::make_shared<const std::vector<std::exception_ptr>>(
+                std::move(errors)
+            ))
+        {
+        }
+        
+        /*
+            errors
+            
+            The exceptions thrown by the bound functions.
+        =====================================================================*/
+        const std::vector<std::exception_ptr>& errors() const
+        {
+            return *this->errors_;
+        }
+        
+    private:
+    
+        // Shared so that copying the exception, as throwing may, does not
+        // copy the list.
+        std::shared_ptr<const std::vector<std::exception_ptr>> errors_;
+};
+
+/*
+    Lets a firing be stopped before all bound functions have executed, see
+    Event::fire(FireContext&, ...). The functions bound to the Event reach the
+    context through FireContext::current(). stop may also be called from
+    another thread, for example to abort a large firing on shutdown.
+*/
+class FireContext
+{
+    public:
+    
+        /*
+            Constructor
+        =====================================================================*/
+        FireContext():
+            stop_requested(false)
+        {
+        }
+        
+#if __cplusplus >= 202002L
+        /*
+            Constructor
+            
+            The context is also stopped once a stop is requested of token.
+        =====================================================================*/
+        explicit FireContext(std::stop_token token):
+            stop_requested(false),
+            token(std::move(token))
+        {
+        }
+#endif
+        
+        /*
+            stop
+            
+            No further functions are executed by the firings using the
+            context, the executing function is not interrupted.
+        =====================================================================*/
+        void stop()
+        {
+            this->stop_requested.store(true, std::memory_order_relaxed);
+        }
+        
+        /*
+            stopped
+            
+            Returns true if the context has been stopped.
+        =====================================================================*/
+        bool stopped() const
+        {
+#if __cplusplus >= 202002L
+            if (this->token.stop_requested())
+            {
+                return true;
+            }
+#endif
+            return this->stop_requested.load(std::memory_order_relaxed);
+        }
+        
+        /*
+            current
+            
+            The context of the innermost firing on this thread that was made
+            with one, or null if there is none.
+        =====================================================================*/
+        static FireContext* current()
+        {
+            return current_slot();
+        }
+        
+    private:
+    
+        template <typename...>
+        friend class Event;
+        
+        FireContext(const FireContext&) = delete;
+        
+        FireContext& operator=(const FireContext&) = delete;
+        
+        /*
+            Makes a context the current one for the lifetime of the Scope.
+        */
+        class Scope
+        {
+            public:
+            
+                explicit Scope(FireContext& context):
+                    previous(current_slot())
+                {
+                    current_slot() = &context;
+                }
+                
+                ~Scope()
+                {
+                    current_slot() = this->previous;
+                }
+                
+            private:
+            
+                FireContext* previous;
+        };
+        
+        static FireContext*& current_slot()
+        {
+            static thread_local FireContext* current = 0;
+            return current;
+        }
+        
+        std::atomic<bool> stop_requested;
+        
+#if __cplusplus >= 202002L
+        std::stop_token token;
+#endif
+};
 
 /*
     Events allow for multiple functions to be executed in response to an
@@ -50,9 +614,9 @@ class Event
         
     private:
     
-        typedef std::list<std::shared_ptr<Function>> FunctionList;
+        struct Slot;
         
-        typedef std::list<std::weak_ptr<Function>> WeakFunctionList;
+        struct Storage;
 
     public:
     
@@ -71,16 +635,9 @@ class Event
                 =============================================================*/
                 ~Bind()
                 {
-                    if (this->is_valid)
+                    if (this->slot)
                     {
-                        assert(
-                            this->event.binds.find(this) !=
-                            this->event.binds.end()
-                        );
-                        this->event.binds.erase(this);
-                        this->event.bound_functions.erase(
-                            this->bound_function_iterator
-                        );
+                        this->slot->storage->remove(this->slot);
                     }
                 }
             
@@ -91,46 +648,164 @@ class Event
                 /*
                     Constructor
                 =============================================================*/
-                Bind(
-                    Event& event,
-                    typename FunctionList::iterator bound_function_iterator
-                ):
-                    event(event),
-                    bound_function_iterator(bound_function_iterator),
-                    is_valid(true)
+                Bind(Slot* slot):
+                    slot(slot)
                 {
                 }
                 
-                void invalidate()
+                // The bound slot, null once the Event has been destroyed.
+                Slot* slot;
+        };
+    
+        /*
+            Owns a group of binds made by bind_many, unbinding whichever are
+            still bound when it is destroyed. The group is one array of slot
+            pointers rather than a Bind per function.
+        */
+        class BindGroup
+        {
+            public:
+            
+                /*
+                    Move Constructor
+                =============================================================*/
+                BindGroup(BindGroup&& other) noexcept:
+                    slots(std::move(other.slots)),
+                    count(other.count)
                 {
-                    assert(this->is_valid);
-                    this->is_valid = false;
+                    other.count = 0;
                 }
                 
-                Event& event;
+                /*
+                    Destructor
+                =============================================================*/
+                ~BindGroup()
+                {
+                    this->unbind_all();
+                }
                 
-                typename FunctionList::iterator bound_function_iterator;
+                BindGroup& operator=(BindGroup&& other) noexcept
+                {
+                    if (this != &other)
+                    {
+                        this->unbind_all();
+                        this->slots = std::move(other.slots);
+                        this->count = other.count;
+                        other.count = 0;
+                    }
+                    return *this;
+                }
                 
-                bool is_valid;
-        };
-    
-        /*
+                /*
+                    size
+                    
+                    The number of functions the group was made with.
+                =============================================================*/
+                std::size_t size() const
+                {
+                    return this->count;
+                }
+                
+                /*
+                    is_bound
+                    
+                    Returns true if function index is still bound.
+                =============================================================*/
+                bool is_bound(std::size_t index) const
+                {
+                    assert(index < this->count);
+                    return this->slots[index] != 0;
+                }
+                
+                /*
+                    unbind
+                    
+                    Unbinds function index early.
+                =============================================================*/
+                void unbind(std::size_t index)
+                {
+                    assert(index < this->count);
+                    if (auto slot = this->slots[index])
+                    {
+                        slot->storage->remove(slot);
+                    }
+                }
+                
+                /*
+                    unbind_all
+                    
+                    Unbinds every function in the group.
+                =============================================================*/
+                void unbind_all()
+                {
+                    for (std::size_t i = 0; i < this->count; ++i)
+                    {
+                        this->unbind(i);
+                    }
+                }
+                
+            private:
+            
+                friend class Event<Args...>;
+                
+                explicit BindGroup(std::size_t count):
+                    slots(new Slot*[count]()),
+                    count(count)
+                {
+                }
+                
+                BindGroup(const BindGroup&) = delete;
+                
+                BindGroup& operator=(const BindGroup&) = delete;
+                
+                // Slots refer back to their entry, so the array is never
+                // resized.
+                std::unique_ptr<Slot*[]> slots;
+                
+                std::size_t count;
+        };
+    
+        /*
             Constructor
         =====================================================================*/
         Event()
         {
         }
         
+        /*
+            Move Constructor
+            
+            Binds to other follow it to the new Event. An Event is a single
+            owning pointer so it is also safe to relocate with memcpy, which
+            lets containers of Events grow without an indirection per Event.
+        =====================================================================*/
+        Event(Event&& other) noexcept:
+            storage(std::move(other.storage))
+        {
+        }
+        
         /*
             Destructor
         =====================================================================*/
         ~Event()
         {
-            // Invalidate any remaining Binds.
-            for(auto bind: this->binds)
+            this->release_storage();
+        }
+        
+        /*
+            Move Assignment
+            
+            Any functions bound to this Event are unbound and Binds to other
+            follow it to this Event.
+        =====================================================================*/
+        Event& operator=(Event&& other) noexcept
+        {
+            if (this != &other)
             {
-                bind->invalidate();
+                this->release_storage();
+                this->storage = std::move(other.storage);
             }
+            return *this;
         }
         
         /*
@@ -142,10 +817,7 @@ class Event
         =====================================================================*/
         void permanent_bind(const Function& function)
         {
-            this->bound_functions.emplace(
-                this->bound_functions.end(),
-                std::make_shared<Function>(function)
-            );
+            this->get_storage().add(function);
         }
         
         /*
@@ -156,53 +828,984 @@ class Event
         =====================================================================*/
         std::shared_ptr<Bind> bind(const Function& function)
         {
-            this->bound_functions.emplace(
-                this->bound_functions.end(),
-                std::make_shared<Function>(function)
+            auto slot = this->get_storage().add(function);
+            std::shared_ptr<Bind> bind(new Bind(slot));
+            slot->handle = &bind->slot;
+            return bind;
+        }
+        
+        /*
+            bind_many
+            
+            Binds every function in functions, a range of callables, at once.
+            Storage for all of them is made in a single allocation and they
+            stay bound for the duration of the BindGroup returned.
+        =====================================================================*/
+        template <typename Range>
+        BindGroup bind_many(const Range& functions)
+        {
+            using std::begin;
+            using std::end;
+            auto count = static_cast<std::size_t>(
+                std::distance(begin(functions), end(functions))
+            );
+            auto& storage = this->get_storage();
+            storage.reserve(storage.live + count);
+            BindGroup group(count);
+            std::size_t i = 0;
+            for (auto& function: functions)
+            {
+                auto slot = storage.add(function);
+                group.slots[i] = slot;
+                slot->handle = &group.slots[i];
+                ++i;
+            }
+            return group;
+        }
+        
+        /*
+            bind
+            
+            Binds a function to the Event on behalf of owner, which must derive
+            from Trackable. The function is unbound when either the Event or
+            owner is destroyed, so no Bind is needed. function may also be a
+            pointer to a member function of owner:
+            
+                event.bind(listener, &Listener::on_event);
+        =====================================================================*/
+        template <typename Owner, typename Callable>
+        void bind(Owner& owner, Callable callable)
+        {
+            static_assert(
+                std::is_base_of<Trackable, Owner>::value,
+                "the owner of a tracked bind must derive from Trackable"
             );
-            auto bound_function_iterator = this->bound_functions.end();
-            --bound_function_iterator;
-            std::shared_ptr<Bind> bind(new Bind(
-                *this,
-                bound_function_iterator
-            ));
-            assert(this->binds.find(bind.get()) == this->binds.end());
-            this->binds.insert(bind.get());
+            auto slot = this->get_storage().add(
+                this->make_function(
+                    owner,
+                    callable,
+                    std::is_member_function_pointer<Callable>()
+                )
+            );
+            slot->track(owner);
+        }
+        
+        /*
+            bind_once
+            
+            Binds a function to the Event that is unbound as it is executed,
+            so it executes at most once.
+        =====================================================================*/
+        void bind_once(const Function& function)
+        {
+            this->get_storage().add(function)->once = true;
+        }
+        
+        /*
+            bind_once
+            
+            Binds a function that executes at most once on behalf of owner,
+            see bind(owner, function).
+        =====================================================================*/
+        template <typename Owner, typename Callable>
+        void bind_once(Owner& owner, Callable callable)
+        {
+            this->bind(owner, callable);
+            this->storage->tail->once = true;
+        }
+        
+        /*
+            bind_decimated
+            
+            Binds a function that only executes on every nth firing of the
+            Event, for the duration of the Bind returned. The firings in
+            between skip it at the cost of a counter decrement.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind_decimated(
+            std::uint32_t n,
+            const Function& function
+        )
+        {
+            if (n == 0)
+            {
+                throw std::invalid_argument("bind_decimated: n must not be 0");
+            }
+            auto bind = this->bind(function);
+            if (n > 1)
+            {
+                auto slot = bind->slot;
+                slot->period = n;
+                slot->skip = n - 1;
+            }
+            return bind;
+        }
+        
+        /*
+            bind_sampled
+            
+            Binds a function that executes on each firing of the Event with
+            the given probability, for the duration of the Bind returned.
+            Rather than drawing a random number on every firing, the number of
+            firings to skip until the next execution is drawn from a
+            geometric distribution, so skipped firings cost a counter
+            decrement.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind_sampled(
+            double probability,
+            const Function& function
+        )
+        {
+            if (!(probability > 0 && probability <= 1))
+            {
+                throw std::invalid_argument(
+                    "bind_sampled: probability must be in (0, 1]"
+                );
+            }
+            auto bind = this->bind(function);
+            if (probability < 1)
+            {
+                auto slot = bind->slot;
+                slot->log_miss = std::log1p(-probability);
+                slot->skip = slot->storage->draw_skip(slot->log_miss);
+            }
             return bind;
         }
         
+        /*
+            reserve
+            
+            Makes room for at least count bound functions so that binding up
+            to that many does not allocate (beyond what the functions
+            themselves need).
+        =====================================================================*/
+        void reserve(std::size_t count)
+        {
+            this->get_storage().reserve(count);
+        }
+        
+        /*
+            has_handlers
+            
+            Returns true if at least one function is bound to the Event.
+        =====================================================================*/
+        bool has_handlers() const
+        {
+            return this->storage && (
+                this->storage->live ||
+                this->storage->has_waiters()
+            );
+        }
+        
+        /*
+            as_sender
+            
+            A sender (see event_sender.hpp) that completes with the arguments
+            of the next firing of the Event, or is stopped if the Event is
+            destroyed first.
+        =====================================================================*/
+        EventSender<Args...> as_sender()
+        {
+            return EventSender<Args...>(*this);
+        }
+        
+        /*
+            bind_receiver
+            
+            Connects receiver to the next firing of the Event and starts
+            waiting. The returned operation is the only state involved, it
+            may live anywhere and destroying it before the firing cancels the
+            wait. Requires event_sender.hpp.
+        =====================================================================*/
+        template <typename Receiver>
+        EventOperation<typename std::decay<Receiver>::type, Args...>
+        bind_receiver(Receiver&& receiver)
+        {
+            EventOperation<typename std::decay<Receiver>::type, Args...>
+                operation(*this, std::forward<Receiver>(receiver));
+            operation.start();
+            return operation;
+        }
+        
+        /*
+            next_future
+            
+            A future that becomes ready with the arguments of the next firing
+            of the Event, so another thread can block until the Event fires.
+            Must be called where binding is allowed, the future itself may
+            then be waited on from any thread. Requires event_future.hpp.
+        =====================================================================*/
+        EventFuture<Args...> next_future()
+        {
+            EventFuture<Args...> future;
+            this->wait(future.waiter());
+            return future;
+        }
+        
+        /*
+            fire_lazy
+            
+            Fires the Event with the arguments returned by factory, but only
+            calls factory if there is at least one function bound. factory
+            returns a std::tuple of the arguments, or for an Event with a
+            single argument may return the argument itself. Returns the number
+            of functions executed.
+        =====================================================================*/
+        template <typename Factory>
+        std::size_t fire_lazy(Factory factory)
+        {
+            if (!this->has_handlers())
+            {
+                return 0;
+            }
+            auto&& result = factory();
+            return this->fire_result(
+                result,
+                std::integral_constant<
+                    bool,
+                    sizeof...(Args) == 1 &&
+                    !event_detail::IsTuple<
+                        typename std::decay<decltype(result)>::type
+                    >::value
+                >()
+            );
+        }
+        
         /*
             fire
             
-            Executes all bound functions using the arguments provided.
+            Executes all bound functions using the arguments provided. Returns
+            the number of functions executed.
+        */
+        std::size_t fire(Args... args)
+        {
+            event_detail::CallDirectly call;
+            return this->fire_until(event_detail::NeverStop(), call, args...);
+        }
+        
+        /*
+            fire_isolated
+            
+            Executes all bound functions using the arguments provided, even
+            if some of them throw. Their exceptions are collected and thrown
+            together as an EventErrors once every function has executed.
+            Returns the number of functions executed.
         */
-        void fire(Args... args)
+        std::size_t fire_isolated(Args... args)
         {
-            WeakFunctionList weak_functions;
-            for(auto& shared_ptr: this->bound_functions)
+            event_detail::CallIsolated call(
+                this->storage ? this->storage->live : 0
+            );
+            auto executed = this->fire_until(
+                event_detail::NeverStop(),
+                call,
+                args...
+            );
+            if (!call.errors.empty())
             {
-                weak_functions.emplace(
-                    weak_functions.end(),
-                    shared_ptr
-                );
+                throw EventErrors(std::move(call.errors));
+            }
+            return executed;
+        }
+        
+        /*
+            fire
+            
+            Executes the bound functions until context is stopped, which is
+            checked before each function. The functions can stop the firing
+            through FireContext::current(). Returns the number of functions
+            executed.
+        */
+        std::size_t fire(FireContext& context, Args... args)
+        {
+            FireContext::Scope scope(context);
+            event_detail::CallDirectly call;
+            return this->fire_until(
+                [&context]{
+                    return context.stopped();
+                },
+                call,
+                args...
+            );
+        }
+        
+#if __cplusplus >= 202002L
+        /*
+            fire
+            
+            Executes the bound functions until a stop is requested of token.
+            Returns the number of functions executed.
+        */
+        std::size_t fire(std::stop_token token, Args... args)
+        {
+            FireContext context(std::move(token));
+            return this->fire(context, args...);
+        }
+#endif
+        
+    private:
+    
+        friend class Bind;
+        
+        template <typename, typename...>
+        friend class EventOperation;
+        
+        friend class EventFuture<Args...>;
+        
+        Event(const Event&) = delete;
+        
+        Event& operator=(const Event&) = delete;
+        
+        /*
+            A bound function. Slots form an intrusive list in the order they
+            were bound. A slot that is unbound while its Event is firing is
+            only marked as removed, it is destroyed once the firing finishes.
+        */
+        struct Slot final: event_detail::TrackedConnection
+        {
+            Slot(Storage& storage, const Function& function):
+                function(function),
+                storage(&storage),
+                handle(0),
+                previous(0),
+                next(0),
+                skip(0),
+                period(0),
+                log_miss(0),
+                once(false),
+                removed(false)
+            {
+            }
+            
+            // Whether the function executes at a reduced rate, see
+            // bind_decimated and bind_sampled.
+            bool is_subrate() const
+            {
+                return this->period || this->log_miss < 0;
+            }
+            
+            void disconnect()
+            {
+                this->storage->remove(this);
+            }
+            
+            using event_detail::TrackedConnection::track;
+            
+            using event_detail::TrackedConnection::untrack;
+            
+            Function function;
+            
+            Storage* storage;
+            
+            // The Bind or BindGroup entry that refers to the slot, if any. It
+            // is cleared when the slot is removed.
+            Slot** handle;
+            
+            Slot* previous;
+            
+            Slot* next;
+            
+            // The number of firings that skip the function before it next
+            // executes.
+            std::uint32_t skip;
+            
+            // Executes on every period-th firing if not 0.
+            std::uint32_t period;
+            
+            // log(1 - probability) of a sampled function, otherwise 0.
+            double log_miss;
+            
+            bool once;
+            
+            bool removed;
+        };
+        
+        /*
+            Everything needed once a function has been bound. It is only
+            allocated on the first bind so that an Event which is never bound
+            to is the size of a pointer.
+        */
+        struct Storage
+        {
+            Storage():
+                head(0),
+                tail(0),
+                live(0),
+                firing(0),
+                dirty(false),
+                orphaned(false),
+                free(0),
+                capacity(0),
+                waiters(0),
+                random(0x9E3779B97F4A7C15ull)
+            {
+            }
+            
+            ~Storage()
+            {
+                this->stop_waiters();
+                // Invalidate any remaining Binds before destroying anything,
+                // a function may own the Bind of a later slot.
+                for (auto slot = this->head; slot; slot = slot->next)
+                {
+                    if (slot->handle)
+                    {
+                        *slot->handle = 0;
+                        slot->handle = 0;
+                    }
+                    slot->untrack();
+                }
+                auto slot = this->head;
+                while (slot)
+                {
+                    auto next = slot->next;
+                    slot->~Slot();
+                    slot = next;
+                }
+            }
+            
+            Slot* add(const Function& function)
+            {
+                if (!this->free)
+                {
+                    // grow geometrically
+                    this->grow(this->capacity ? this->capacity : 1);
+                }
+                auto free = this->free;
+                this->free = free->next;
+                Slot* slot;
+                try
+                {
+                    slot = new (free) Slot(*this, function);
+                }
+                catch (...)
+                {
+                    this->free = free;
+                    throw;
+                }
+                slot->previous = this->tail;
+                if (this->tail)
+                {
+                    this->tail->next = slot;
+                }
+                else
+                {
+                    this->head = slot;
+                }
+                this->tail = slot;
+                ++this->live;
+                return slot;
+            }
+            
+            void remove(Slot* slot)
+            {
+                assert(!slot->removed);
+                slot->removed = true;
+                --this->live;
+                if (slot->handle)
+                {
+                    *slot->handle = 0;
+                    slot->handle = 0;
+                }
+                slot->untrack();
+                if (this->firing)
+                {
+                    this->dirty = true;
+                }
+                else
+                {
+                    this->erase(slot);
+                }
+            }
+            
+            void erase(Slot* slot)
+            {
+                this->unlink(slot);
+                this->destroy(slot);
             }
-            for(auto& weak_ptr: weak_functions)
+            
+            void unlink(Slot* slot)
             {
-                if (auto shared_ptr = weak_ptr.lock())
+                if (slot->previous)
+                {
+                    slot->previous->next = slot->next;
+                }
+                else
+                {
+                    this->head = slot->next;
+                }
+                if (slot->next)
+                {
+                    slot->next->previous = slot->previous;
+                }
+                else
                 {
-                    (*shared_ptr)(args...);
+                    this->tail = slot->previous;
                 }
             }
+            
+            // Destroying the function may unbind other slots, so the slot
+            // must be unlinked first.
+            void destroy(Slot* slot)
+            {
+                slot->~Slot();
+                auto free = new (slot) FreeSlot();
+                free->next = this->free;
+                this->free = free;
+            }
+            
+            void reserve(std::size_t count)
+            {
+                if (count > this->capacity)
+                {
+                    this->grow(count - this->capacity);
+                }
+            }
+            
+            // Adds count slots worth of memory in one allocation.
+            void grow(std::size_t count)
+            {
+                std::unique_ptr<SlotMemory[]> chunk(new SlotMemory[count]);
+                for (std::size_t i = count; i-- > 0;)
+                {
+                    auto free = new (&chunk[i]) FreeSlot();
+                    free->next = this->free;
+                    this->free = free;
+                }
+                this->chunks.push_back(std::move(chunk));
+                this->capacity += count;
+            }
+            
+            // Destroys the slots that were removed while firing.
+            void compact()
+            {
+                // Unlink every removed slot before destroying any, a
+                // function may own the Bind of a later slot.
+                Slot* removed = 0;
+                auto slot = this->head;
+                while (slot)
+                {
+                    auto next = slot->next;
+                    if (slot->removed)
+                    {
+                        this->unlink(slot);
+                        slot->next = removed;
+                        removed = slot;
+                    }
+                    slot = next;
+                }
+                this->dirty = false;
+                while (removed)
+                {
+                    auto next = removed->next;
+                    this->destroy(removed);
+                    removed = next;
+                }
+            }
+            
+            // Called instead of destroying the Storage when its Event is
+            // destroyed while firing, the last firing destroys it.
+            void orphan()
+            {
+                for (auto slot = this->head; slot; slot = slot->next)
+                {
+                    if (!slot->removed)
+                    {
+                        this->remove(slot);
+                    }
+                }
+                this->orphaned = true;
+                this->stop_waiters();
+            }
+            
+            // Draws the number of firings a sampled function skips before it
+            // next executes.
+            std::uint32_t draw_skip(double log_miss)
+            {
+                // xorshift64
+                this->random ^= this->random << 13;
+                this->random ^= this->random >> 7;
+                this->random ^= this->random << 17;
+                // uniform in (0, 1]
+                auto uniform = double((this->random >> 11) + 1) *
+                    (1.0 / 9007199254740992.0);
+                auto skip = std::floor(std::log(uniform) / log_miss);
+                return skip < 4294967295.0 ? std::uint32_t(skip) : 4294967295u;
+            }
+            
+            // Drops abandoned waiters from the front of the list, which is
+            // where a future that timed out waiting on a quiet Event is,
+            // returning true if any waiter is left.
+            bool has_waiters()
+            {
+                while (auto waiter = this->waiters)
+                {
+                    if (!waiter->is_abandoned())
+                    {
+                        return true;
+                    }
+                    waiter->unlink();
+                    waiter->stop();
+                }
+                return false;
+            }
+            
+            void stop_waiters()
+            {
+                while (auto waiter = this->waiters)
+                {
+                    waiter->unlink();
+                    waiter->stop();
+                }
+            }
+            
+            Slot* head;
+            
+            Slot* tail;
+            
+            // The number of slots that have not been removed.
+            std::size_t live;
+            
+            // The number of firings in progress.
+            std::size_t firing;
+            
+            bool dirty;
+            
+            bool orphaned;
+            
+            // Slots are allocated in chunks, unused slots form a free list.
+            
+            struct FreeSlot
+            {
+                FreeSlot* next;
+            };
+            
+            typedef typename std::aligned_storage<
+                sizeof(Slot),
+                alignof(Slot)
+            >::type SlotMemory;
+            
+            std::vector<std::unique_ptr<SlotMemory[]>> chunks;
+            
+            FreeSlot* free;
+            
+            std::size_t capacity;
+            
+            // Waiters for the next firing, most recent first.
+            event_detail::EventWaiter<Args...>* waiters;
+            
+            // The state of the generator used by sampled functions.
+            std::uint64_t random;
+        };
+        
+        /*
+            Marks a Storage as firing for the lifetime of the Firing, so that
+            slots are not destroyed out from underneath it.
+        */
+        class Firing
+        {
+            public:
+            
+                explicit Firing(Storage& storage):
+                    storage(storage)
+                {
+                    ++this->storage.firing;
+                }
+                
+                ~Firing()
+                {
+                    if (--this->storage.firing)
+                    {
+                        return;
+                    }
+                    if (this->storage.orphaned)
+                    {
+                        delete &this->storage;
+                    }
+                    else if (this->storage.dirty)
+                    {
+                        this->storage.compact();
+                    }
+                }
+                
+            private:
+            
+                Storage& storage;
+        };
+        
+        /*
+            Adapts a pointer to a member function into a Function.
+        */
+        template <typename Owner, typename Method>
+        struct MemberFunction
+        {
+            void operator()(Args... args) const
+            {
+                (this->owner->*this->method)(args...);
+            }
+            
+            Owner* owner;
+            
+            Method method;
+        };
+        
+        // Makes waiter wait for the next firing.
+        void wait(event_detail::EventWaiter<Args...>& waiter)
+        {
+            auto& storage = this->get_storage();
+            storage.has_waiters();
+            waiter.link(storage.waiters);
         }
         
-    private:
+        Storage& get_storage()
+        {
+            if (!this->storage)
+            {
+                this->storage.reset(new Storage());
+            }
+            return *this->storage;
+        }
+        
+        void release_storage()
+        {
+            if (this->storage && this->storage->firing)
+            {
+                this->storage->orphan();
+                this->storage.release();
+            }
+            this->storage.reset();
+        }
+        
+        template <typename Owner, typename Method>
+        static Function make_function(
+            Owner& owner,
+            Method method,
+            std::true_type
+        )
+        {
+            return MemberFunction<Owner, Method>{&owner, method};
+        }
+        
+        template <typename Owner, typename Callable>
+        static Function make_function(
+            Owner&,
+            Callable callable,
+            std::false_type
+        )
+        {
+            return callable;
+        }
+        
+        // The firing loop, stopped returns true to stop before the next
+        // function and call executes each function.
+        template <typename Stopped, typename Call>
+        std::size_t fire_until(Stopped stopped, Call& call, Args&... args)
+        {
+            auto storage = this->storage.get();
+            if (!storage || (!storage->live && !storage->has_waiters()))
+            {
+                return 0;
+            }
+            std::size_t executed = 0;
+            Firing firing(*storage);
+            // Functions bound while firing are not executed until the next
+            // fire, functions unbound while firing are skipped.
+            auto last = storage->tail;
+            for (auto slot = storage->head; slot; slot = slot->next)
+            {
+                if (slot->skip)
+                {
+                    // a decimated or sampled function sits this firing out
+                    --slot->skip;
+                }
+                else if (!slot->removed)
+                {
+                    if (stopped())
+                    {
+                        return executed;
+                    }
+                    if (slot->once)
+                    {
+                        storage->remove(slot);
+                    }
+                    else if (slot->is_subrate())
+                    {
+                        slot->skip = slot->period ?
+                            slot->period - 1 :
+                            storage->draw_skip(slot->log_miss);
+                    }
+                    call(slot->function, args...);
+                    ++executed;
+                    if (storage->orphaned)
+                    {
+                        return executed;
+                    }
+                }
+                if (slot == last)
+                {
+                    break;
+                }
+            }
+            if (storage->waiters && !stopped())
+            {
+                executed += this->complete_waiters(*storage, args...);
+            }
+            return executed;
+        }
+        
+        // Completes everything waiting on the Storage, in the order they
+        // started waiting. Waiters that start waiting meanwhile wait for the
+        // next firing.
+        std::size_t complete_waiters(Storage& storage, Args&... args)
+        {
+            event_detail::EventWaiter<Args...>* pending = 0;
+            while (auto waiter = storage.waiters)
+            {
+                waiter->unlink();
+                waiter->link(pending);
+            }
+            std::size_t completed = 0;
+            while (auto waiter = pending)
+            {
+                waiter->unlink();
+                if (waiter->is_abandoned())
+                {
+                    waiter->stop();
+                    continue;
+                }
+                waiter->complete(args...);
+                ++completed;
+            }
+            return completed;
+        }
+        
+        template <typename Result>
+        std::size_t fire_result(Result& result, std::true_type)
+        {
+            return this->fire(result);
+        }
+        
+        template <typename Tuple>
+        std::size_t fire_result(Tuple& tuple, std::false_type)
+        {
+            return this->fire_tuple(
+                tuple,
+                typename event_detail::MakeIndexSequence<
+                    sizeof...(Args)
+                >::Type()
+            );
+        }
+        
+        template <typename Tuple, std::size_t... Indices>
+        std::size_t fire_tuple(
+            Tuple& tuple,
+            event_detail::IndexSequence<Indices...>
+        )
+        {
+            (void)tuple;
+            return this->fire(std::get<Indices>(tuple)...);
+        }
     
-        friend class Bind;
+        std::unique_ptr<Storage> storage;
     
-        FunctionList bound_functions;
+};
+
+namespace event_detail
+{
+    template <typename Function>
+    struct WhenAny: Trackable
+    {
+        explicit WhenAny(const Function& function):
+            function(function)
+        {
+        }
+        
+        void complete()
+        {
+            // Unbind from the other Events, then run.
+            auto function = this->function;
+            this->disconnect_all();
+            function();
+        }
         
-        std::set<Bind*> binds;
+        Function function;
+    };
     
-};
+    template <typename Function>
+    struct WhenAll
+    {
+        WhenAll(const Function& function, std::size_t remaining):
+            function(function),
+            remaining(remaining)
+        {
+        }
+        
+        Function function;
+        
+        std::size_t remaining;
+    };
+    
+    template <typename Function, typename... Args>
+    void bind_when_any(
+        const std::shared_ptr<WhenAny<Function>>& state,
+        Event<Args...>& event
+    )
+    {
+        // The bind keeps the state alive until one of the Events fires or
+        // they are all destroyed.
+        event.bind_once(*state, [state](Args...){
+            state->complete();
+        });
+    }
+    
+    template <typename Function, typename... Args>
+    void bind_when_all(
+        const std::shared_ptr<WhenAll<Function>>& state,
+        Event<Args...>& event
+    )
+    {
+        event.bind_once([state](Args...){
+            if (--state->remaining == 0)
+            {
+                state->function();
+            }
+        });
+    }
+}
+
+/*
+    when_any
+    
+    Executes function once, the first time any of the events fire. It is
+    unbound from the rest of the events at that point.
+*/
+template <typename Function, typename... Events>
+void when_any(const Function& function, Events&... events)
+{
+    auto state = std::make_shared<event_detail::WhenAny<Function>>(function);
+    const int expand[] = {0, (
+        event_detail::bind_when_any(state, events),
+        0
+    )...};
+    (void)expand;
+}
+
+/*
+    when_all
+    
+    Executes function once, after each of the events has fired at least once.
+*/
+template <typename Function, typename... Events>
+void when_all(const Function& function, Events&... events)
+{
+    auto state = std::make_shared<event_detail::WhenAll<Function>>(
+        function,
+        sizeof...(Events)
+    );
+    const int expand[] = {0, (
+        event_detail::bind_when_all(state, events),
+        0
+    )...};
+    (void)expand;
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,676 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_CODEC_HPP
+#define EVENT_CODEC_HPP
+
+// standard library
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+// event
+#include "event.hpp"
+
+namespace event_detail
+{
+    inline std::size_t varint_size(std::uint64_t value)
+    {
+        std::size_t size = 1;
+        while (value >= 0x80)
+        {
+            value >>= 7;
+            ++size;
+        }
+        return size;
+    }
+
+    inline void put_varint(unsigned char*& out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            *out++ = static_cast<unsigned char>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<unsigned char>(value);
+    }
+
+    inline std::uint64_t get_varint(
+        const unsigned char*& in,
+        const unsigned char* end
+    )
+    {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (in == end)
+            {
+                break;
+            }
+            auto byte = *in++;
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        throw std::runtime_error("event codec: truncated input");
+    }
+
+    inline void check_remaining(
+        const unsigned char* in,
+        const unsigned char* end,
+        std::uint64_t size
+    )
+    {
+        if (size > static_cast<std::uint64_t>(end - in))
+        {
+            throw std::runtime_error("event codec: truncated input");
+        }
+    }
+
+    // Checks for count elements of element_size bytes each, count is read
+    // from the input so the product may not fit.
+    inline void check_remaining(
+        const unsigned char* in,
+        const unsigned char* end,
+        std::uint64_t count,
+        std::size_t element_size
+    )
+    {
+        if (count > static_cast<std::uint64_t>(end - in) / element_size)
+        {
+            throw std::runtime_error("event codec: truncated input");
+        }
+    }
+}
+
+/*
+    A read only view of a trivially copyable value inside an encoded buffer.
+    The view refers directly to the buffer when the value happens to be
+    suitably aligned, otherwise it holds a copy.
+*/
+template <typename T>
+class EventCodecView
+{
+    public:
+
+        /*
+            Constructor
+        =====================================================================*/
+        explicit EventCodecView(const unsigned char* data)
+        {
+            if (reinterpret_cast<std::uintptr_t>(data) % alignof(T) == 0)
+            {
+                this->pointer = reinterpret_cast<const T*>(data);
+            }
+            else
+            {
+                std::memcpy(&this->copy, data, sizeof(T));
+                this->pointer = reinterpret_cast<const T*>(&this->copy);
+            }
+        }
+
+        EventCodecView(const EventCodecView& other):
+            copy(other.copy),
+            pointer(
+                other.is_copy() ?
+                reinterpret_cast<const T*>(&this->copy) :
+                other.pointer
+            )
+        {
+        }
+
+        EventCodecView& operator=(const EventCodecView&) = delete;
+
+        operator const T&() const
+        {
+            return *this->pointer;
+        }
+
+        const T& get() const
+        {
+            return *this->pointer;
+        }
+
+    private:
+
+        bool is_copy() const
+        {
+            return this->pointer == reinterpret_cast<const T*>(&this->copy);
+        }
+
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type copy;
+
+        const T* pointer;
+};
+
+/*
+    Describes how a single (decayed) argument type is turned into bytes and
+    back. Specialize it to make other types encodable:
+
+        typedef ... Decoded;
+        static std::size_t size(const T& value);
+        static void encode(unsigned char*& out, const T& value);
+        static Decoded decode(
+            const unsigned char*& in,
+            const unsigned char* end
+        );
+
+    size returns the exact number of bytes encode will write, encode and
+    decode advance the pointer they are given. Decoded is what handlers are
+    handed, it must be convertible to T and may refer into the buffer.
+*/
+template <typename T, typename Enable = void>
+struct EventCodecTraits;
+
+namespace event_detail
+{
+    // Views are trivially copyable but are encoded by what they refer to.
+    template <typename T>
+    struct IsCodecView: std::false_type
+    {
+    };
+
+#if __cplusplus >= 201703L
+    template <>
+    struct IsCodecView<std::string_view>: std::true_type
+    {
+    };
+#endif
+
+#if __cplusplus >= 202002L
+    template <typename T>
+    struct IsCodecView<std::span<const T>>: std::true_type
+    {
+    };
+#endif
+
+    // True if T always encodes to sizeof(T) bytes.
+    template <typename T>
+    struct IsFixedSize: std::integral_constant<
+        bool,
+        std::is_trivially_copyable<T>::value && !IsCodecView<T>::value
+    >
+    {
+    };
+}
+
+/*
+    Trivially copyable types are copied byte for byte.
+*/
+template <typename T>
+struct EventCodecTraits<
+    T,
+    typename std::enable_if<
+        event_detail::IsFixedSize<T>::value
+    >::type
+>
+{
+    typedef EventCodecView<T> Decoded;
+
+    static std::size_t size(const T&)
+    {
+        return sizeof(T);
+    }
+
+    static void encode(unsigned char*& out, const T& value)
+    {
+        std::memcpy(out, &value, sizeof(T));
+        out += sizeof(T);
+    }
+
+    static Decoded decode(const unsigned char*& in, const unsigned char* end)
+    {
+        event_detail::check_remaining(in, end, sizeof(T));
+        Decoded decoded(in);
+        in += sizeof(T);
+        return decoded;
+    }
+};
+
+/*
+    Strings are a length followed by their characters.
+*/
+template <>
+struct EventCodecTraits<std::string>
+{
+    typedef std::string Decoded;
+
+    static std::size_t size(const std::string& value)
+    {
+        return event_detail::varint_size(value.size()) + value.size();
+    }
+
+    static void encode(unsigned char*& out, const std::string& value)
+    {
+        event_detail::put_varint(out, value.size());
+        std::memcpy(out, value.data(), value.size());
+        out += value.size();
+    }
+
+    static Decoded decode(const unsigned char*& in, const unsigned char* end)
+    {
+        auto size = event_detail::get_varint(in, end);
+        event_detail::check_remaining(in, end, size);
+        Decoded decoded(reinterpret_cast<const char*>(in), size);
+        in += size;
+        return decoded;
+    }
+};
+
+/*
+    Vectors are a length followed by their elements. Vectors of trivially
+    copyable elements are copied as a single block.
+*/
+template <typename T, typename Allocator>
+struct EventCodecTraits<std::vector<T, Allocator>>
+{
+    typedef std::vector<T, Allocator> Decoded;
+
+    static std::size_t size(const std::vector<T, Allocator>& value)
+    {
+        return (
+            event_detail::varint_size(value.size()) +
+            size_elements(value, std::is_trivially_copyable<T>())
+        );
+    }
+
+    static void encode(
+        unsigned char*& out,
+        const std::vector<T, Allocator>& value
+    )
+    {
+        event_detail::put_varint(out, value.size());
+        encode_elements(out, value, std::is_trivially_copyable<T>());
+    }
+
+    static Decoded decode(const unsigned char*& in, const unsigned char* end)
+    {
+        auto size = event_detail::get_varint(in, end);
+        Decoded decoded;
+        decode_elements(
+            in,
+            end,
+            size,
+            decoded,
+            std::is_trivially_copyable<T>()
+        );
+        return decoded;
+    }
+
+    private:
+
+        static std::size_t size_elements(
+            const std::vector<T, Allocator>& value,
+            std::true_type
+        )
+        {
+            return value.size() * sizeof(T);
+        }
+
+        static std::size_t size_elements(
+            const std::vector<T, Allocator>& value,
+            std::false_type
+        )
+        {
+            std::size_t size = 0;
+            for (auto& element: value)
+            {
+                size += EventCodecTraits<T>::size(element);
+            }
+            return size;
+        }
+
+        static void encode_elements(
+            unsigned char*& out,
+            const std::vector<T, Allocator>& value,
+            std::true_type
+        )
+        {
+            if (!value.empty())
+            {
+                std::memcpy(out, value.data(), value.size() * sizeof(T));
+            }
+            out += value.size() * sizeof(T);
+        }
+
+        static void encode_elements(
+            unsigned char*& out,
+            const std::vector<T, Allocator>& value,
+            std::false_type
+        )
+        {
+            for (auto& element: value)
+            {
+                EventCodecTraits<T>::encode(out, element);
+            }
+        }
+
+        static void decode_elements(
+            const unsigned char*& in,
+            const unsigned char* end,
+            std::uint64_t size,
+            Decoded& decoded,
+            std::true_type
+        )
+        {
+            event_detail::check_remaining(in, end, size, sizeof(T));
+            decoded.resize(size);
+            if (size)
+            {
+                std::memcpy(decoded.data(), in, size * sizeof(T));
+            }
+            in += size * sizeof(T);
+        }
+
+        static void decode_elements(
+            const unsigned char*& in,
+            const unsigned char* end,
+            std::uint64_t size,
+            Decoded& decoded,
+            std::false_type
+        )
+        {
+            for (std::uint64_t i = 0; i < size; ++i)
+            {
+                decoded.emplace_back(EventCodecTraits<T>::decode(in, end));
+            }
+        }
+};
+
+#if __cplusplus >= 201703L
+/*
+    String views are encoded like strings, but decode to a view of the
+    characters in the buffer.
+*/
+template <>
+struct EventCodecTraits<std::string_view>
+{
+    typedef std::string_view Decoded;
+
+    static std::size_t size(std::string_view value)
+    {
+        return event_detail::varint_size(value.size()) + value.size();
+    }
+
+    static void encode(unsigned char*& out, std::string_view value)
+    {
+        event_detail::put_varint(out, value.size());
+        std::memcpy(out, value.data(), value.size());
+        out += value.size();
+    }
+
+    static Decoded decode(const unsigned char*& in, const unsigned char* end)
+    {
+        auto size = event_detail::get_varint(in, end);
+        event_detail::check_remaining(in, end, size);
+        Decoded decoded(reinterpret_cast<const char*>(in), size);
+        in += size;
+        return decoded;
+    }
+};
+#endif
+
+#if __cplusplus >= 202002L
+/*
+    Spans of byte sized elements are encoded like vectors, but decode to a
+    span of the elements in the buffer. Wider elements would need the buffer
+    to be aligned, so those should be passed as vectors instead.
+*/
+template <typename T>
+struct EventCodecTraits<
+    std::span<const T>,
+    typename std::enable_if<
+        std::is_trivially_copyable<T>::value && alignof(T) == 1
+    >::type
+>
+{
+    typedef std::span<const T> Decoded;
+
+    static std::size_t size(std::span<const T> value)
+    {
+        return event_detail::varint_size(value.size()) + value.size_bytes();
+    }
+
+    static void encode(unsigned char*& out, std::span<const T> value)
+    {
+        event_detail::put_varint(out, value.size());
+        if (!value.empty())
+        {
+            std::memcpy(out, value.data(), value.size_bytes());
+        }
+        out += value.size_bytes();
+    }
+
+    static Decoded decode(const unsigned char*& in, const unsigned char* end)
+    {
+        auto size = event_detail::get_varint(in, end);
+        event_detail::check_remaining(in, end, size, sizeof(T));
+        Decoded decoded(reinterpret_cast<const T*>(in), size);
+        in += size * sizeof(T);
+        return decoded;
+    }
+};
+#endif
+
+namespace event_detail
+{
+    template <typename... Types>
+    struct TypeList
+    {
+    };
+
+    /*
+        The object a decoded argument is held in while the handler runs. A
+        non-const reference needs an object of its own that the handler may
+        modify, anything else can use whatever the traits decoded.
+    */
+    template <typename Arg>
+    struct CodecArgument
+    {
+        typedef typename std::decay<Arg>::type Value;
+
+        typedef typename std::conditional<
+            std::is_lvalue_reference<Arg>::value &&
+            !std::is_const<typename std::remove_reference<Arg>::type>::value,
+            Value,
+            typename EventCodecTraits<Value>::Decoded
+        >::type Type;
+    };
+
+    template <typename... Args>
+    struct CodecFire
+    {
+        Event<Args...>& event;
+
+        template <typename... Decoded>
+        void operator()(Decoded&... decoded)
+        {
+            this->event.fire(decoded...);
+        }
+    };
+}
+
+/*
+    Turns the arguments of an Event signature into bytes and back.
+
+    Arguments are laid out back to back with no padding or type information.
+    When every argument is trivially copyable, and not a view, the encoding
+    has a fixed size and is a sequence of memcpys.
+*/
+template <typename... Args>
+class EventCodec
+{
+    public:
+
+        /*
+            is_fixed_size
+
+            True if every encoding of the signature is the same number of
+            bytes. String views and spans are trivially copyable but are
+            encoded by what they refer to, so they are never fixed size.
+        =====================================================================*/
+        static const bool is_fixed_size = event_detail::And<
+            event_detail::IsFixedSize<
+                typename std::decay<Args>::type
+            >::value...
+        >::value;
+
+        /*
+            size
+
+            The number of bytes encode will write for the arguments.
+        =====================================================================*/
+        static std::size_t size(
+            const typename std::decay<Args>::type&... args
+        )
+        {
+            std::size_t size = 0;
+            const int expand[] = {0, (
+                size += EventCodecTraits<
+                    typename std::decay<Args>::type
+                >::size(args),
+                0
+            )...};
+            (void)expand;
+            return size;
+        }
+
+        /*
+            encode
+
+            Writes the arguments to out, which must have room for at least
+            size(args...) bytes. Returns the end of the written bytes.
+        =====================================================================*/
+        static unsigned char* encode(
+            unsigned char* out,
+            const typename std::decay<Args>::type&... args
+        )
+        {
+            const int expand[] = {0, (
+                EventCodecTraits<
+                    typename std::decay<Args>::type
+                >::encode(out, args),
+                0
+            )...};
+            (void)expand;
+            return out;
+        }
+
+        /*
+            decode
+
+            Decodes one set of arguments from [in, end) and calls function
+            with them. Arguments the function takes by const reference (or as
+            a view) may refer into the buffer, so they are only valid for the
+            duration of the call. Returns the end of the consumed bytes,
+            throws std::runtime_error if the input is truncated.
+        =====================================================================*/
+        template <typename Function>
+        static const unsigned char* decode(
+            const unsigned char* in,
+            const unsigned char* end,
+            Function&& function
+        )
+        {
+            decode_next(in, end, function, event_detail::TypeList<Args...>());
+            return in;
+        }
+
+        /*
+            fire
+
+            Decodes one set of arguments from [in, end) and fires event with
+            them. Returns the end of the consumed bytes.
+        =====================================================================*/
+        static const unsigned char* fire(
+            Event<Args...>& event,
+            const unsigned char* in,
+            const unsigned char* end
+        )
+        {
+            return decode(in, end, event_detail::CodecFire<Args...>{event});
+        }
+
+    private:
+
+        template <typename Function, typename... Decoded>
+        static void decode_next(
+            const unsigned char*&,
+            const unsigned char*,
+            Function& function,
+            event_detail::TypeList<>,
+            Decoded&... decoded
+        )
+        {
+            function(decoded...);
+        }
+
+        // Each argument is decoded into a local of its own frame so that
+        // views which hold a copy are never moved once handed out.
+        template <
+            typename Function,
+            typename Arg,
+            typename... Rest,
+            typename... Decoded
+        >
+        static void decode_next(
+            const unsigned char*& in,
+            const unsigned char* end,
+            Function& function,
+            event_detail::TypeList<Arg, Rest...>,
+            Decoded&... decoded
+        )
+        {
+            typename event_detail::CodecArgument<Arg>::Type value(
+                EventCodecTraits<
+                    typename event_detail::CodecArgument<Arg>::Value
+                >::decode(in, end)
+            );
+            decode_next(
+                in,
+                end,
+                function,
+                event_detail::TypeList<Rest...>(),
+                decoded...,
+                value
+            );
+        }
+};
+
+template <typename... Args>
+const bool EventCodec<Args...>::is_fixed_size;
+
+#endif
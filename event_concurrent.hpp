@@ -0,0 +1,398 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_CONCURRENT_HPP
+#define EVENT_CONCURRENT_HPP
+
+// standard library
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace event_detail
+{
+    /*
+        A function of a ConcurrentEvent executing on this thread. Frames form a
+        stack per thread so that unbinding from within a function knows not to
+        wait for itself.
+    */
+    struct ConcurrentFrame
+    {
+        explicit ConcurrentFrame(const void* slot):
+            slot(slot),
+            previous(top())
+        {
+            top() = this;
+        }
+
+        ~ConcurrentFrame()
+        {
+            top() = this->previous;
+        }
+
+        // Returns the number of frames on this thread executing slot.
+        static std::size_t count(const void* slot)
+        {
+            std::size_t count = 0;
+            for (auto frame = top(); frame; frame = frame->previous)
+            {
+                if (frame->slot == slot)
+                {
+                    ++count;
+                }
+            }
+            return count;
+        }
+
+        static ConcurrentFrame*& top()
+        {
+            static thread_local ConcurrentFrame* top = 0;
+            return top;
+        }
+
+        const void* slot;
+
+        ConcurrentFrame* previous;
+    };
+}
+
+/*
+    An Event that may be fired, bound to and unbound from any number of
+    threads at once.
+
+    Destroying a Bind blocks until no other thread is executing its function,
+    and the function is never executed once the destructor returns, so a
+    function may safely refer to an object that is destroyed right after its
+    Bind. A function that destroys its own Bind does not wait for itself.
+
+    Firing is lock-free. Each function has a counter of the threads executing
+    it, which is what unbinding waits on. The list of functions is an
+    immutable snapshot that is replaced by binding and unbinding, which take
+    a lock among themselves.
+*/
+template <typename... Args>
+class ConcurrentEvent
+{
+    public:
+
+        typedef std::function<void(Args...)> Function;
+
+    private:
+
+        struct Slot
+        {
+            explicit Slot(const Function& function):
+                function(function),
+                in_flight(0),
+                bound(true)
+            {
+            }
+
+            // Stops the function from executing again, then waits for the
+            // executions already started by other threads.
+            void disconnect()
+            {
+                this->bound = false;
+                auto own = event_detail::ConcurrentFrame::count(this);
+                while (this->in_flight.load() > own)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            Function function;
+
+            std::atomic<std::size_t> in_flight;
+
+            std::atomic<bool> bound;
+        };
+
+        struct Snapshot
+        {
+            Snapshot():
+                references(1)
+            {
+            }
+
+            // One for being the current snapshot and one for each firing
+            // using it.
+            std::atomic<std::size_t> references;
+
+            std::vector<std::shared_ptr<Slot>> slots;
+        };
+
+        struct State
+        {
+            State():
+                current(0),
+                epoch(0)
+            {
+                this->readers[0] = 0;
+                this->readers[1] = 0;
+            }
+
+            ~State()
+            {
+                release(this->current.load());
+            }
+
+            // Takes a reference to the current snapshot. Only the few
+            // instructions needed for this are protected by the epoch, not
+            // the firing itself.
+            Snapshot* acquire()
+            {
+                for (;;)
+                {
+                    auto epoch = this->epoch.load();
+                    auto& readers = this->readers[epoch & 1];
+                    ++readers;
+                    if (this->epoch.load() == epoch)
+                    {
+                        auto snapshot = this->current.load();
+                        if (snapshot)
+                        {
+                            ++snapshot->references;
+                        }
+                        --readers;
+                        return snapshot;
+                    }
+                    --readers;
+                }
+            }
+
+            static void release(Snapshot* snapshot)
+            {
+                if (snapshot && --snapshot->references == 0)
+                {
+                    delete snapshot;
+                }
+            }
+
+            void bind(const std::shared_ptr<Slot>& slot)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->slots.push_back(slot);
+                this->publish();
+            }
+
+            void unbind(const std::shared_ptr<Slot>& slot)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->slots.erase(
+                    std::find(this->slots.begin(), this->slots.end(), slot)
+                );
+                this->publish();
+            }
+
+            // Replaces the current snapshot, then drops its reference to the
+            // old one once no thread can be about to take a reference to it.
+            void publish()
+            {
+                Snapshot* snapshot = 0;
+                if (!this->slots.empty())
+                {
+                    snapshot = new Snapshot();
+                    snapshot->slots = this->slots;
+                }
+                auto old = this->current.exchange(snapshot);
+                auto epoch = this->epoch.load();
+                this->epoch.store(epoch + 1);
+                while (this->readers[epoch & 1].load())
+                {
+                    std::this_thread::yield();
+                }
+                release(old);
+            }
+
+            // Guards slots, only taken by binding and unbinding.
+            std::mutex mutex;
+
+            std::vector<std::shared_ptr<Slot>> slots;
+
+            std::atomic<Snapshot*> current;
+
+            std::atomic<std::size_t> epoch;
+
+            // The number of threads taking a reference to the current
+            // snapshot, by the parity of the epoch they started in.
+            std::atomic<std::size_t> readers[2];
+        };
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a ConcurrentEvent, the
+            function is unbound when the Bind is destroyed. Destruction waits
+            for other threads executing the function to return.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (auto state = this->state.lock())
+                    {
+                        state->unbind(this->slot);
+                    }
+                    this->slot->disconnect();
+                }
+
+            private:
+
+                friend class ConcurrentEvent<Args...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(
+                    const std::shared_ptr<State>& state,
+                    const std::shared_ptr<Slot>& slot
+                ):
+                    state(state),
+                    slot(slot)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                std::shared_ptr<Slot> slot;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        ConcurrentEvent():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            bind
+
+            Binds a function to the ConcurrentEvent for the duration of the
+            Bind returned.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(const Function& function)
+        {
+            auto slot = std::make_shared<Slot>(function);
+            this->state->bind(slot);
+            return std::shared_ptr<Bind>(new Bind(this->state, slot));
+        }
+
+        /*
+            fire
+
+            Executes all bound functions using the arguments provided. Returns
+            the number of functions executed.
+        =====================================================================*/
+        std::size_t fire(Args... args)
+        {
+            Snapshot* snapshot = this->state->acquire();
+            if (!snapshot)
+            {
+                return 0;
+            }
+            Release release(snapshot);
+            std::size_t executed = 0;
+            for (auto& slot: snapshot->slots)
+            {
+                Call call(*slot);
+                // checked after announcing the call, so that a disconnect
+                // either sees the call or the call sees the disconnect
+                if (slot->bound)
+                {
+                    event_detail::ConcurrentFrame frame(slot.get());
+                    slot->function(args...);
+                    ++executed;
+                }
+            }
+            return executed;
+        }
+
+    private:
+
+        ConcurrentEvent(const ConcurrentEvent&) = delete;
+
+        ConcurrentEvent& operator=(const ConcurrentEvent&) = delete;
+
+        /*
+            Counts a thread as executing a slot for the lifetime of the Call.
+        */
+        class Call
+        {
+            public:
+
+                explicit Call(Slot& slot):
+                    slot(slot)
+                {
+                    ++this->slot.in_flight;
+                }
+
+                ~Call()
+                {
+                    --this->slot.in_flight;
+                }
+
+            private:
+
+                Slot& slot;
+        };
+
+        /*
+            Releases a firing's reference to a snapshot.
+        */
+        class Release
+        {
+            public:
+
+                explicit Release(Snapshot* snapshot):
+                    snapshot(snapshot)
+                {
+                }
+
+                ~Release()
+                {
+                    State::release(this->snapshot);
+                }
+
+            private:
+
+                Snapshot* snapshot;
+        };
+
+        std::shared_ptr<State> state;
+};
+
+#endif
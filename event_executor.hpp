@@ -0,0 +1,218 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_EXECUTOR_HPP
+#define EVENT_EXECUTOR_HPP
+
+// standard library
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+// event
+#include "event.hpp"
+
+namespace event_detail
+{
+    /*
+        A firing of an Event with a copy of its arguments, to be performed
+        later. The Event must outlive it.
+    */
+    template <typename... Args>
+    class DeferredFire
+    {
+        public:
+
+            template <typename... Values>
+            DeferredFire(Event<Args...>& event, Values&&... values):
+                event(&event),
+                values(std::forward<Values>(values)...)
+            {
+            }
+
+            std::size_t operator()()
+            {
+                return this->fire(
+                    typename MakeIndexSequence<sizeof...(Args)>::Type()
+                );
+            }
+
+        private:
+
+            template <std::size_t... Indices>
+            std::size_t fire(IndexSequence<Indices...>)
+            {
+                return this->event->fire(std::get<Indices>(this->values)...);
+            }
+
+            Event<Args...>* event;
+
+            std::tuple<typename std::decay<Args>::type...> values;
+    };
+}
+
+/*
+    Something that runs work posted to it, possibly later. Anything that
+    defers work (timers, queued or asynchronous firing) goes through an
+    EventExecutor, so that the same code can be driven by real time or by a
+    SimulationExecutor.
+
+    Work is posted to a lane. Work on the same lane that is due at the same
+    time runs in the order it was posted, a lane typically stands for the
+    thread the work was posted from.
+*/
+class EventExecutor
+{
+    public:
+
+        typedef std::chrono::steady_clock Clock;
+
+        typedef std::function<void()> Work;
+
+        /*
+            Destructor
+        =====================================================================*/
+        virtual ~EventExecutor()
+        {
+        }
+
+        /*
+            now
+
+            The current time as seen by work run on the executor.
+        =====================================================================*/
+        virtual Clock::time_point now() const = 0;
+
+        /*
+            post_at
+
+            Runs work on the executor no sooner than when.
+        =====================================================================*/
+        virtual void post_at(
+            Clock::time_point when,
+            Work work,
+            std::size_t lane = 0
+        ) = 0;
+
+        /*
+            post
+
+            Runs work on the executor as soon as possible.
+        =====================================================================*/
+        void post(Work work, std::size_t lane = 0)
+        {
+            this->post_at(this->now(), std::move(work), lane);
+        }
+
+        /*
+            post_after
+
+            Runs work on the executor once delay has passed.
+        =====================================================================*/
+        void post_after(
+            Clock::duration delay,
+            Work work,
+            std::size_t lane = 0
+        )
+        {
+            this->post_at(this->now() + delay, std::move(work), lane);
+        }
+
+        /*
+            fire
+
+            Fires event on the executor as soon as possible. The arguments are
+            copied and the Event must outlive the firing.
+        =====================================================================*/
+        template <typename... Args, typename... Values>
+        void fire(Event<Args...>& event, Values&&... values)
+        {
+            this->fire_on(
+                0,
+                Clock::duration::zero(),
+                event,
+                std::forward<Values>(values)...
+            );
+        }
+
+        /*
+            fire_after
+
+            Fires event on the executor once delay has passed.
+        =====================================================================*/
+        template <typename... Args, typename... Values>
+        void fire_after(
+            Clock::duration delay,
+            Event<Args...>& event,
+            Values&&... values
+        )
+        {
+            this->fire_on(0, delay, event, std::forward<Values>(values)...);
+        }
+
+        /*
+            fire_on
+
+            Fires event on the given lane of the executor once delay has
+            passed.
+        =====================================================================*/
+        template <typename... Args, typename... Values>
+        void fire_on(
+            std::size_t lane,
+            Clock::duration delay,
+            Event<Args...>& event,
+            Values&&... values
+        )
+        {
+            event_detail::DeferredFire<Args...> deferred(
+                event,
+                std::forward<Values>(values)...
+            );
+            this->post_after(
+                delay,
+                [this, deferred]() mutable {
+                    this->fired(deferred());
+                },
+                lane
+            );
+        }
+
+    protected:
+
+        /*
+            fired
+
+            Called after each firing performed through the executor with the
+            number of functions that were executed.
+        =====================================================================*/
+        virtual void fired(std::size_t)
+        {
+        }
+};
+
+#endif
@@ -0,0 +1,467 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_FIBER_HPP
+#define EVENT_FIBER_HPP
+
+// standard library
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+// posix
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+// event
+#include "event.hpp"
+
+namespace event_detail
+{
+    /*
+        Tell AddressSanitizer about switches between stacks, without which it
+        reports false positives on fiber stacks. No-ops otherwise.
+    */
+    inline void fiber_start_switch(
+        void** fake_stack,
+        const void* bottom,
+        std::size_t size
+    )
+    {
+#if defined(__SANITIZE_ADDRESS__)
+        __sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#else
+        (void)fake_stack;
+        (void)bottom;
+        (void)size;
+#endif
+    }
+
+    inline void fiber_finish_switch(
+        void* fake_stack,
+        const void** bottom,
+        std::size_t* size
+    )
+    {
+#if defined(__SANITIZE_ADDRESS__)
+        __sanitizer_finish_switch_fiber(fake_stack, bottom, size);
+#else
+        (void)fake_stack;
+        (void)bottom;
+        (void)size;
+#endif
+    }
+}
+
+/*
+    Runs functions as fibers on the calling thread: each fiber has its own
+    stack and can give up the thread with yield or suspend, letting the
+    thread carry on with other work until the fiber is resumed.
+
+    Functions bound with bind_fiber start as a fiber when the Event fires. A
+    function that waits part way through no longer holds up the firing, the
+    firing moves on to the next function and the fiber is resumed later by
+    run.
+
+    Stacks are taken from a pool and each has a guard page below it, so a
+    fiber that overflows its stack faults rather than corrupting memory.
+    POSIX only. A scheduler and its fibers must only be used from one thread.
+*/
+class EventFiberScheduler
+{
+    public:
+
+        typedef std::function<void()> Work;
+
+        /*
+            An opaque handle to a fiber, used to wake it after suspend.
+        */
+        class Fiber;
+
+        /*
+            Constructor
+
+            Fibers get stacks of at least stack_size bytes.
+        =====================================================================*/
+        explicit EventFiberScheduler(std::size_t stack_size = 64 * 1024):
+            page_size(::sysconf(_SC_PAGESIZE)),
+            stack_size(
+                (stack_size + this->page_size - 1) /
+                this->page_size *
+                this->page_size
+            ),
+            running(0),
+            thread_stack_bottom(0),
+            thread_stack_size(0)
+        {
+        }
+
+        /*
+            Destructor
+
+            Fibers that are still suspended are abandoned, the objects on
+            their stacks are not destroyed.
+        =====================================================================*/
+        ~EventFiberScheduler()
+        {
+            assert(!this->running);
+            for (auto& fiber: this->fibers)
+            {
+                this->free_stacks.push_back(fiber->stack);
+            }
+            for (auto& stack: this->free_stacks)
+            {
+                ::munmap(stack.memory, stack.size);
+            }
+        }
+
+        /*
+            spawn
+
+            Starts work as a fiber. Called outside of a fiber the work runs
+            straight away until it finishes or waits, called from a fiber it
+            runs once the calling fiber waits.
+        =====================================================================*/
+        void spawn(Work work)
+        {
+            std::unique_ptr<Fiber> fiber(new Fiber(*this, std::move(work)));
+            fiber->stack = this->allocate_stack();
+            ::getcontext(&fiber->context);
+            fiber->context.uc_stack.ss_sp =
+                static_cast<char*>(fiber->stack.memory) + this->page_size;
+            fiber->context.uc_stack.ss_size =
+                fiber->stack.size - this->page_size;
+            fiber->context.uc_link = 0;
+            ::makecontext(&fiber->context, &EventFiberScheduler::entry, 0);
+            auto raw = fiber.get();
+            this->fibers.push_back(std::move(fiber));
+            if (current())
+            {
+                this->ready.push_back(raw);
+            }
+            else
+            {
+                this->resume(raw);
+            }
+        }
+
+        /*
+            bind_fiber
+
+            Binds a function to event that runs as a fiber of the scheduler
+            each time the event fires. The arguments are copied, since the
+            fiber may outlive the firing.
+        =====================================================================*/
+        template <typename... Args>
+        std::shared_ptr<typename Event<Args...>::Bind> bind_fiber(
+            Event<Args...>& event,
+            const typename Event<Args...>::Function& function
+        )
+        {
+            return event.bind([this, function](Args... args){
+                this->spawn(std::bind(function, args...));
+            });
+        }
+
+        /*
+            run
+
+            Resumes fibers that are ready until none are. Returns the number
+            of fibers still suspended.
+        =====================================================================*/
+        std::size_t run()
+        {
+            assert(!current());
+            while (!this->ready.empty())
+            {
+                auto fiber = this->ready.front();
+                this->ready.pop_front();
+                this->resume(fiber);
+            }
+            return this->fibers.size();
+        }
+
+        /*
+            wake
+
+            Makes a suspended fiber ready, it continues on the next run.
+        =====================================================================*/
+        void wake(Fiber& fiber)
+        {
+            assert(&fiber.scheduler == this);
+            if (fiber.suspended)
+            {
+                fiber.suspended = false;
+                this->ready.push_back(&fiber);
+            }
+        }
+
+        /*
+            current
+
+            The fiber executing on this thread, or null outside of a fiber.
+        =====================================================================*/
+        static Fiber* current()
+        {
+            return current_slot();
+        }
+
+        /*
+            yield
+
+            Gives up the thread from within a fiber, which stays ready and
+            continues on the next run.
+        =====================================================================*/
+        static void yield()
+        {
+            auto fiber = current();
+            assert(fiber);
+            fiber->scheduler.ready.push_back(fiber);
+            fiber->scheduler.switch_out(*fiber);
+        }
+
+        /*
+            suspend
+
+            Gives up the thread from within a fiber until the fiber is passed
+            to wake.
+        =====================================================================*/
+        static void suspend()
+        {
+            auto fiber = current();
+            assert(fiber);
+            fiber->suspended = true;
+            fiber->scheduler.switch_out(*fiber);
+        }
+
+        class Fiber
+        {
+            private:
+
+                friend class EventFiberScheduler;
+
+                Fiber(EventFiberScheduler& scheduler, Work work):
+                    scheduler(scheduler),
+                    work(std::move(work)),
+                    suspended(false),
+                    finished(false),
+                    fake_stack(0)
+                {
+                }
+
+                Fiber(const Fiber&) = delete;
+
+                Fiber& operator=(const Fiber&) = delete;
+
+                struct Stack
+                {
+                    void* memory;
+
+                    std::size_t size;
+                };
+
+                EventFiberScheduler& scheduler;
+
+                Work work;
+
+                ucontext_t context;
+
+                Stack stack;
+
+                bool suspended;
+
+                bool finished;
+
+                std::exception_ptr error;
+
+                // Used by AddressSanitizer while the fiber is switched out.
+                void* fake_stack;
+        };
+
+    private:
+
+        typedef Fiber::Stack Stack;
+
+        EventFiberScheduler(const EventFiberScheduler&) = delete;
+
+        EventFiberScheduler& operator=(const EventFiberScheduler&) = delete;
+
+        static Fiber*& current_slot()
+        {
+            static thread_local Fiber* current = 0;
+            return current;
+        }
+
+        static void entry()
+        {
+            auto fiber = current();
+            event_detail::fiber_finish_switch(
+                0,
+                &fiber->scheduler.thread_stack_bottom,
+                &fiber->scheduler.thread_stack_size
+            );
+            try
+            {
+                fiber->work();
+            }
+            catch (...)
+            {
+                fiber->error = std::current_exception();
+            }
+            fiber->work = nullptr;
+            fiber->finished = true;
+            fiber->scheduler.switch_out(*fiber);
+        }
+
+        // Switches from the thread to fiber until it waits or finishes.
+        void resume(Fiber* fiber)
+        {
+            assert(!this->running);
+            this->running = fiber;
+            current_slot() = fiber;
+            void* fake_stack = 0;
+            event_detail::fiber_start_switch(
+                &fake_stack,
+                fiber->context.uc_stack.ss_sp,
+                fiber->context.uc_stack.ss_size
+            );
+            ::swapcontext(&this->thread_context, &fiber->context);
+            event_detail::fiber_finish_switch(fake_stack, 0, 0);
+            current_slot() = 0;
+            this->running = 0;
+            if (fiber->finished)
+            {
+                auto error = fiber->error;
+                this->retire(fiber);
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        // Switches from fiber back to the thread that resumed it.
+        void switch_out(Fiber& fiber)
+        {
+            // a finished fiber's stack is never returned to
+            event_detail::fiber_start_switch(
+                fiber.finished ? 0 : &fiber.fake_stack,
+                this->thread_stack_bottom,
+                this->thread_stack_size
+            );
+            ::swapcontext(&fiber.context, &this->thread_context);
+            event_detail::fiber_finish_switch(
+                fiber.fake_stack,
+                &this->thread_stack_bottom,
+                &this->thread_stack_size
+            );
+        }
+
+        void retire(Fiber* fiber)
+        {
+            this->free_stacks.push_back(fiber->stack);
+            for (auto i = this->fibers.begin(); i != this->fibers.end(); ++i)
+            {
+                if (i->get() == fiber)
+                {
+                    this->fibers.erase(i);
+                    break;
+                }
+            }
+        }
+
+        Stack allocate_stack()
+        {
+            if (!this->free_stacks.empty())
+            {
+                auto stack = this->free_stacks.back();
+                this->free_stacks.pop_back();
+                return stack;
+            }
+            Stack stack;
+            stack.size = this->stack_size + this->page_size;
+            stack.memory = ::mmap(
+                0,
+                stack.size,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+                -1,
+                0
+            );
+            if (stack.memory == MAP_FAILED)
+            {
+                throw std::system_error(
+                    errno,
+                    std::generic_category(),
+                    "mmap fiber stack"
+                );
+            }
+            // the stack grows down, towards the guard page
+            if (::mprotect(stack.memory, this->page_size, PROT_NONE) != 0)
+            {
+                auto error = errno;
+                ::munmap(stack.memory, stack.size);
+                throw std::system_error(
+                    error,
+                    std::generic_category(),
+                    "mprotect fiber stack guard"
+                );
+            }
+            return stack;
+        }
+
+        std::size_t page_size;
+
+        std::size_t stack_size;
+
+        // Where the thread continues when the running fiber waits.
+        ucontext_t thread_context;
+
+        Fiber* running;
+
+        // The stack of the thread, as reported to AddressSanitizer.
+        const void* thread_stack_bottom;
+
+        std::size_t thread_stack_size;
+
+        std::deque<Fiber*> ready;
+
+        std::vector<std::unique_ptr<Fiber>> fibers;
+
+        std::vector<Stack> free_stacks;
+};
+
+#endif
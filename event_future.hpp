@@ -0,0 +1,403 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_FUTURE_HPP
+#define EVENT_FUTURE_HPP
+
+// standard library
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if defined(__linux__)
+// linux
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+// event
+#include "event.hpp"
+
+namespace event_detail
+{
+    /*
+        Blocks while value is expected, for at most timeout if it is not
+        negative. May return early, callers check the value again. Uses a
+        futex on Linux, elsewhere it polls with a growing sleep.
+    */
+    inline void atomic_wait(
+        std::atomic<std::uint32_t>& value,
+        std::uint32_t expected,
+        std::chrono::nanoseconds timeout
+    )
+    {
+#if defined(__linux__)
+        static_assert(
+            sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+            "futex requires a plain 32 bit word"
+        );
+        timespec relative;
+        timespec* relative_pointer = 0;
+        if (timeout.count() >= 0)
+        {
+            relative.tv_sec = timeout.count() / 1000000000;
+            relative.tv_nsec = timeout.count() % 1000000000;
+            relative_pointer = &relative;
+        }
+        ::syscall(
+            SYS_futex,
+            reinterpret_cast<std::uint32_t*>(&value),
+            FUTEX_WAIT_PRIVATE,
+            expected,
+            relative_pointer,
+            0,
+            0
+        );
+#else
+        auto sleep = std::chrono::microseconds(50);
+        if (timeout.count() >= 0 && timeout < sleep)
+        {
+            sleep = std::chrono::duration_cast<std::chrono::microseconds>(
+                timeout
+            );
+        }
+        if (value.load() == expected)
+        {
+            std::this_thread::sleep_for(sleep);
+        }
+#endif
+    }
+
+    inline void atomic_notify_all(std::atomic<std::uint32_t>& value)
+    {
+#if defined(__linux__)
+        ::syscall(
+            SYS_futex,
+            reinterpret_cast<std::uint32_t*>(&value),
+            FUTEX_WAKE_PRIVATE,
+            INT_MAX,
+            0,
+            0,
+            0
+        );
+#else
+        (void)value;
+#endif
+    }
+}
+
+/*
+    The result of waiting on an EventFuture.
+*/
+enum class EventFutureStatus
+{
+    // The Event fired, the arguments are available.
+    ready,
+    // The Event did not fire in time.
+    timeout,
+    // The Event was destroyed without firing.
+    stopped
+};
+
+/*
+    Becomes ready with the arguments of the next firing of an Event, returned
+    by Event::next_future. The state shared with the Event is allocated once,
+    including room for the arguments, and linked directly into the Event's
+    list of waiters. Waiting blocks on an atomic rather than a mutex and
+    condition variable, so thousands of futures are cheap.
+
+    A future destroyed before the Event fires is abandoned and no longer
+    counts as a handler. The Event drops it the next time it fires, checks
+    has_handlers or makes another future.
+*/
+template <typename... Args>
+class EventFuture
+{
+    public:
+
+        typedef std::tuple<typename std::decay<Args>::type...> Values;
+
+        /*
+            Move Constructor
+        =====================================================================*/
+        EventFuture(EventFuture&& other) noexcept:
+            state(other.state)
+        {
+            other.state = 0;
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~EventFuture()
+        {
+            if (this->state)
+            {
+                this->state->release();
+            }
+        }
+
+        EventFuture& operator=(EventFuture&& other) noexcept
+        {
+            std::swap(this->state, other.state);
+            return *this;
+        }
+
+        /*
+            status
+
+            Returns the status without waiting, timeout meaning the Event has
+            not fired yet.
+        =====================================================================*/
+        EventFutureStatus status() const
+        {
+            return to_status(this->state->status.load(
+                std::memory_order_acquire
+            ));
+        }
+
+        /*
+            wait
+
+            Blocks until the Event fires or is destroyed.
+        =====================================================================*/
+        EventFutureStatus wait() const
+        {
+            for (;;)
+            {
+                auto status = this->state->status.load(
+                    std::memory_order_acquire
+                );
+                if (status != waiting)
+                {
+                    return to_status(status);
+                }
+                event_detail::atomic_wait(
+                    this->state->status,
+                    waiting,
+                    std::chrono::nanoseconds(-1)
+                );
+            }
+        }
+
+        /*
+            wait_for
+
+            Blocks until the Event fires or is destroyed, or duration has
+            passed.
+        =====================================================================*/
+        template <typename Rep, typename Period>
+        EventFutureStatus wait_for(
+            const std::chrono::duration<Rep, Period>& duration
+        ) const
+        {
+            return this->wait_until(
+                std::chrono::steady_clock::now() + duration
+            );
+        }
+
+        /*
+            wait_until
+
+            Blocks until the Event fires or is destroyed, or time is reached.
+        =====================================================================*/
+        template <typename Clock, typename Duration>
+        EventFutureStatus wait_until(
+            const std::chrono::time_point<Clock, Duration>& time
+        ) const
+        {
+            for (;;)
+            {
+                auto status = this->state->status.load(
+                    std::memory_order_acquire
+                );
+                if (status != waiting)
+                {
+                    return to_status(status);
+                }
+                auto remaining = std::chrono::duration_cast<
+                    std::chrono::nanoseconds
+                >(time - Clock::now());
+                if (remaining.count() <= 0)
+                {
+                    return EventFutureStatus::timeout;
+                }
+                event_detail::atomic_wait(
+                    this->state->status,
+                    waiting,
+                    remaining
+                );
+            }
+        }
+
+        /*
+            get
+
+            Waits for the Event to fire and returns its arguments. Throws
+            std::logic_error if the Event was destroyed without firing.
+        =====================================================================*/
+        const Values& get() const
+        {
+            if (this->wait() != EventFutureStatus::ready)
+            {
+                throw std::logic_error(
+                    "EventFuture: the Event was destroyed without firing"
+                );
+            }
+            return *this->state->values();
+        }
+
+    private:
+
+        friend class Event<Args...>;
+
+        EventFuture(const EventFuture&) = delete;
+
+        EventFuture& operator=(const EventFuture&) = delete;
+
+        static const std::uint32_t waiting = 0;
+
+        static const std::uint32_t ready = 1;
+
+        static const std::uint32_t stopped = 2;
+
+        static EventFutureStatus to_status(std::uint32_t status)
+        {
+            if (status == ready)
+            {
+                return EventFutureStatus::ready;
+            }
+            return status == stopped ?
+                EventFutureStatus::stopped :
+                EventFutureStatus::timeout;
+        }
+
+        /*
+            Shared by the future and the Event, owned by whichever lets go of
+            it last.
+        */
+        class State final: public event_detail::EventWaiter<Args...>
+        {
+            public:
+
+                State():
+                    status(waiting),
+                    references(2)
+                {
+                }
+
+                ~State()
+                {
+                    if (this->status.load() == ready)
+                    {
+                        this->values()->~Values();
+                    }
+                }
+
+                void complete(Args&... args)
+                {
+                    try
+                    {
+                        new (&this->storage) Values(args...);
+                        this->finish(ready);
+                    }
+                    catch (...)
+                    {
+                        // the arguments could not be copied, treat the
+                        // future as never fired
+                        this->finish(stopped);
+                    }
+                }
+
+                void stop()
+                {
+                    this->finish(stopped);
+                }
+
+                // The future let go of its reference, only the Event's is
+                // left.
+                bool is_abandoned() const
+                {
+                    return this->references.load(
+                        std::memory_order_acquire
+                    ) == 1;
+                }
+
+                void release()
+                {
+                    if (this->references.fetch_sub(1) == 1)
+                    {
+                        delete this;
+                    }
+                }
+
+                Values* values()
+                {
+                    return reinterpret_cast<Values*>(&this->storage);
+                }
+
+                std::atomic<std::uint32_t> status;
+
+            private:
+
+                // Called by the Event side once, wakes the waiting thread.
+                void finish(std::uint32_t status)
+                {
+                    this->status.store(status, std::memory_order_release);
+                    event_detail::atomic_notify_all(this->status);
+                    this->release();
+                }
+
+                std::atomic<int> references;
+
+                typename std::aligned_storage<
+                    sizeof(Values),
+                    std::alignment_of<Values>::value
+                >::type storage;
+        };
+
+        EventFuture():
+            state(new State())
+        {
+        }
+
+        event_detail::EventWaiter<Args...>& waiter()
+        {
+            return *this->state;
+        }
+
+        State* state;
+};
+
+#endif
@@ -0,0 +1,621 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_GRAPH_HPP
+#define EVENT_GRAPH_HPP
+
+// standard library
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+// event
+#include "event_thread_pool.hpp"
+
+/*
+    The ordering constraints of a function bound to a GraphEvent, in terms of
+    the tags of other binds:
+
+        GraphOrder().after("cache_invalidate").before("present")
+*/
+class GraphOrder
+{
+    public:
+
+        /*
+            after
+
+            The function executes after every function bound with tag.
+        =====================================================================*/
+        GraphOrder& after(const std::string& tag)
+        {
+            this->predecessors.push_back(tag);
+            return *this;
+        }
+
+        /*
+            before
+
+            The function executes before every function bound with tag.
+        =====================================================================*/
+        GraphOrder& before(const std::string& tag)
+        {
+            this->successors.push_back(tag);
+            return *this;
+        }
+
+    private:
+
+        template <typename... Args>
+        friend class GraphEvent;
+
+        std::vector<std::string> predecessors;
+
+        std::vector<std::string> successors;
+};
+
+/*
+    An Event whose bound functions are ordered by the constraints they were
+    bound with rather than only by the order they were bound in. Functions
+    without constraints between them are independent and fire_graph executes
+    them in parallel.
+
+    The topological order is cached. Binding places the new function into the
+    cached order directly when its constraints allow it, and unbinding never
+    invalidates the order, so a full sort is only needed when a bind can not
+    be placed. fire only walks the order, the dependencies between functions
+    are worked out by the first fire_graph after the binds change. Binding a
+    function that would create a cycle throws std::logic_error.
+
+    GraphEvents may be bound to, unbound from and fired from any thread.
+*/
+template <typename... Args>
+class GraphEvent
+{
+    public:
+
+        typedef std::function<void(Args...)> Function;
+
+    private:
+
+        struct Node;
+
+        struct State;
+
+    public:
+
+        /*
+            An object that has ownership of the bind to a GraphEvent, the
+            function is unbound when the Bind is destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (auto state = this->state.lock())
+                    {
+                        state->unbind(this->node);
+                    }
+                }
+
+            private:
+
+                friend class GraphEvent<Args...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(
+                    const std::shared_ptr<State>& state,
+                    const std::shared_ptr<Node>& node
+                ):
+                    state(state),
+                    node(node)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                std::shared_ptr<Node> node;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        GraphEvent():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            bind
+
+            Binds a function to the GraphEvent under tag for the duration of
+            the Bind returned.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(
+            const std::string& tag,
+            const Function& function,
+            const GraphOrder& order = GraphOrder()
+        )
+        {
+            auto node = std::make_shared<Node>(tag, function, order);
+            this->state->bind(node);
+            return std::shared_ptr<Bind>(new Bind(this->state, node));
+        }
+
+        /*
+            fire
+
+            Executes all bound functions one after another in an order that
+            satisfies their constraints. Returns the number of functions
+            executed.
+        =====================================================================*/
+        std::size_t fire(Args... args)
+        {
+            auto order = this->state->get_order();
+            std::size_t executed = 0;
+            for (auto& node: *order)
+            {
+                if (node->bound)
+                {
+                    node->function(args...);
+                    ++executed;
+                }
+            }
+            return executed;
+        }
+
+        /*
+            fire_graph
+
+            Executes all bound functions, running functions that do not depend
+            on each other in parallel on pool. The calling thread takes part
+            and returns once every function has executed. If functions throw,
+            the first exception is rethrown once the rest have finished.
+            Returns the number of functions executed.
+        =====================================================================*/
+        std::size_t fire_graph(EventThreadPool& pool, Args... args)
+        {
+            auto plan = this->state->get_plan();
+            if (plan->nodes.empty())
+            {
+                return 0;
+            }
+            auto firing = std::make_shared<Firing>(
+                plan,
+                [&](Function& function){
+                    function(args...);
+                }
+            );
+            firing->run(pool);
+            return firing->finish();
+        }
+
+    private:
+
+        GraphEvent(const GraphEvent&) = delete;
+
+        GraphEvent& operator=(const GraphEvent&) = delete;
+
+        struct Node
+        {
+            Node(
+                const std::string& tag,
+                const Function& function,
+                const GraphOrder& order
+            ):
+                tag(tag),
+                function(function),
+                predecessors(order.predecessors),
+                successors(order.successors),
+                sequence(0),
+                bound(true)
+            {
+            }
+
+            // Returns true if this node must execute before other.
+            bool precedes(const Node& other) const
+            {
+                return (
+                    std::find(
+                        this->successors.begin(),
+                        this->successors.end(),
+                        other.tag
+                    ) != this->successors.end() ||
+                    std::find(
+                        other.predecessors.begin(),
+                        other.predecessors.end(),
+                        this->tag
+                    ) != other.predecessors.end()
+                );
+            }
+
+            std::string tag;
+
+            Function function;
+
+            std::vector<std::string> predecessors;
+
+            std::vector<std::string> successors;
+
+            // The order the node was bound in, used to keep unconstrained
+            // functions in bind order.
+            std::uint64_t sequence;
+
+            std::atomic<bool> bound;
+        };
+
+        typedef std::vector<std::shared_ptr<Node>> Order;
+
+        /*
+            An immutable snapshot of the order and the dependencies between
+            functions, shared by firings until the binds change.
+        */
+        struct Plan
+        {
+            std::vector<std::shared_ptr<Node>> nodes;
+
+            std::vector<std::vector<std::size_t>> successors;
+
+            std::vector<std::size_t> predecessor_counts;
+
+            std::vector<std::size_t> roots;
+        };
+
+        struct State
+        {
+            State():
+                sequence(0)
+            {
+            }
+
+            void bind(const std::shared_ptr<Node>& node)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                node->sequence = this->sequence++;
+                // The node can go anywhere after its last predecessor and
+                // before its first successor.
+                std::size_t earliest = 0;
+                auto latest = this->order.size();
+                for (std::size_t i = 0; i < this->order.size(); ++i)
+                {
+                    if (this->order[i]->precedes(*node))
+                    {
+                        earliest = i + 1;
+                    }
+                    if (
+                        node->precedes(*this->order[i]) &&
+                        latest == this->order.size()
+                    )
+                    {
+                        latest = i;
+                    }
+                }
+                if (earliest <= latest)
+                {
+                    this->order.insert(this->order.begin() + latest, node);
+                }
+                else
+                {
+                    auto order = this->order;
+                    order.push_back(node);
+                    this->order = sort(order);
+                }
+                this->snapshot.reset();
+                this->plan.reset();
+            }
+
+            void unbind(const std::shared_ptr<Node>& node)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                node->bound = false;
+                // Removing a node from a topological order leaves it valid.
+                this->order.erase(
+                    std::find(this->order.begin(), this->order.end(), node)
+                );
+                this->snapshot.reset();
+                this->plan.reset();
+            }
+
+            // Functions may bind and unbind while firing, so firings walk a
+            // snapshot of the order rather than the order itself.
+            std::shared_ptr<const Order> get_order()
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                return this->get_snapshot();
+            }
+
+            std::shared_ptr<const Plan> get_plan()
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (!this->plan)
+                {
+                    this->plan = make_plan(*this->get_snapshot());
+                }
+                return this->plan;
+            }
+
+            std::shared_ptr<const Order> get_snapshot()
+            {
+                if (!this->snapshot)
+                {
+                    this->snapshot = std::make_shared<const Order>(
+                        this->order
+                    );
+                }
+                return this->snapshot;
+            }
+
+            std::mutex mutex;
+
+            Order order;
+
+            std::shared_ptr<const Order> snapshot;
+
+            std::shared_ptr<const Plan> plan;
+
+            std::uint64_t sequence;
+        };
+
+        /*
+            The state of one fire_graph, shared with the pool threads helping
+            with it.
+        */
+        class Firing: public std::enable_shared_from_this<Firing>
+        {
+            public:
+
+                Firing(
+                    const std::shared_ptr<const Plan>& plan,
+                    const std::function<void(Function&)>& invoke
+                ):
+                    plan(plan),
+                    invoke(invoke),
+                    predecessor_counts(plan->predecessor_counts),
+                    ready(plan->roots.begin(), plan->roots.end()),
+                    outstanding(plan->nodes.size()),
+                    executed(0)
+                {
+                }
+
+                void run(EventThreadPool& pool)
+                {
+                    this->pool = &pool;
+                    // Ask for help with every root but the one this thread
+                    // takes. Helpers start changing ready straight away, so
+                    // it is only read under the lock.
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    auto roots = this->ready.size();
+                    lock.unlock();
+                    for (std::size_t i = 1; i < roots; ++i)
+                    {
+                        this->post_helper();
+                    }
+                    lock.lock();
+                    while (this->outstanding)
+                    {
+                        if (this->ready.empty())
+                        {
+                            this->condition.wait(lock);
+                            continue;
+                        }
+                        this->execute_one(lock);
+                    }
+                }
+
+                std::size_t finish()
+                {
+                    if (this->error)
+                    {
+                        std::rethrow_exception(this->error);
+                    }
+                    return this->executed;
+                }
+
+            private:
+
+                void post_helper()
+                {
+                    auto self = this->shared_from_this();
+                    this->pool->post([self]{
+                        std::unique_lock<std::mutex> lock(self->mutex);
+                        while (!self->ready.empty())
+                        {
+                            self->execute_one(lock);
+                        }
+                    });
+                }
+
+                // Executes one ready node with the lock released, then
+                // releases the nodes that were waiting on it.
+                void execute_one(std::unique_lock<std::mutex>& lock)
+                {
+                    auto index = this->ready.front();
+                    this->ready.pop_front();
+                    auto& node = this->plan->nodes[index];
+                    lock.unlock();
+                    auto executed = false;
+                    std::exception_ptr error;
+                    if (node->bound)
+                    {
+                        try
+                        {
+                            this->invoke(node->function);
+                            executed = true;
+                        }
+                        catch (...)
+                        {
+                            error = std::current_exception();
+                        }
+                    }
+                    lock.lock();
+                    if (executed)
+                    {
+                        ++this->executed;
+                    }
+                    if (error && !this->error)
+                    {
+                        this->error = error;
+                    }
+                    std::size_t released = 0;
+                    for (auto successor: this->plan->successors[index])
+                    {
+                        if (--this->predecessor_counts[successor] == 0)
+                        {
+                            this->ready.push_back(successor);
+                            ++released;
+                        }
+                    }
+                    --this->outstanding;
+                    // Keep one for whoever is running this, hand out the
+                    // rest.
+                    for (std::size_t i = 1; i < released; ++i)
+                    {
+                        this->post_helper();
+                    }
+                    if (released || !this->outstanding)
+                    {
+                        this->condition.notify_all();
+                    }
+                }
+
+                std::shared_ptr<const Plan> plan;
+
+                std::function<void(Function&)> invoke;
+
+                std::vector<std::size_t> predecessor_counts;
+
+                std::mutex mutex;
+
+                std::condition_variable condition;
+
+                std::deque<std::size_t> ready;
+
+                std::size_t outstanding;
+
+                std::size_t executed;
+
+                std::exception_ptr error;
+
+                EventThreadPool* pool;
+        };
+
+        // Kahn's algorithm, taking the earliest bound of the ready nodes
+        // first. Throws std::logic_error if there is a cycle.
+        static std::vector<std::shared_ptr<Node>> sort(
+            const std::vector<std::shared_ptr<Node>>& nodes
+        )
+        {
+            auto plan = make_edges(nodes);
+            typedef std::pair<std::uint64_t, std::size_t> Entry;
+            std::priority_queue<
+                Entry,
+                std::vector<Entry>,
+                std::greater<Entry>
+            > ready;
+            for (auto root: plan.roots)
+            {
+                ready.push(Entry(nodes[root]->sequence, root));
+            }
+            std::vector<std::shared_ptr<Node>> sorted;
+            while (!ready.empty())
+            {
+                auto index = ready.top().second;
+                ready.pop();
+                sorted.push_back(nodes[index]);
+                for (auto successor: plan.successors[index])
+                {
+                    if (--plan.predecessor_counts[successor] == 0)
+                    {
+                        ready.push(Entry(
+                            nodes[successor]->sequence,
+                            successor
+                        ));
+                    }
+                }
+            }
+            if (sorted.size() != nodes.size())
+            {
+                throw std::logic_error("GraphEvent: bind creates a cycle");
+            }
+            return sorted;
+        }
+
+        static Plan make_edges(const std::vector<std::shared_ptr<Node>>& nodes)
+        {
+            Plan plan;
+            plan.successors.resize(nodes.size());
+            plan.predecessor_counts.resize(nodes.size());
+            for (std::size_t i = 0; i < nodes.size(); ++i)
+            {
+                for (std::size_t j = 0; j < nodes.size(); ++j)
+                {
+                    if (i != j && nodes[i]->precedes(*nodes[j]))
+                    {
+                        plan.successors[i].push_back(j);
+                        ++plan.predecessor_counts[j];
+                    }
+                }
+            }
+            for (std::size_t i = 0; i < nodes.size(); ++i)
+            {
+                if (!plan.predecessor_counts[i])
+                {
+                    plan.roots.push_back(i);
+                }
+            }
+            return plan;
+        }
+
+        static std::shared_ptr<const Plan> make_plan(
+            const std::vector<std::shared_ptr<Node>>& nodes
+        )
+        {
+            std::shared_ptr<Plan> plan(new Plan(make_edges(nodes)));
+            plan->nodes = nodes;
+            return plan;
+        }
+
+        std::shared_ptr<State> state;
+};
+
+#endif
@@ -0,0 +1,535 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_HIERARCHY_HPP
+#define EVENT_HIERARCHY_HPP
+
+// standard library
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+    The phase a bubbling firing is in when a function executes.
+*/
+enum class EventPhase
+{
+    // The ancestors of the target, from the root down.
+    capture,
+    // The target itself.
+    target,
+    // The ancestors of the target, from the parent up.
+    bubble
+};
+
+/*
+    Events for a tree of nodes, such as the widgets of a UI or the objects of a
+    scene graph. Functions are bound to nodes and a firing at a node travels
+    from the root down to it (capture) and then back up to the root (bubble),
+    executing the functions bound to every node along the way. Any function may
+    stop the firing from travelling further.
+
+    Every node caches the flattened list of functions a firing at it executes,
+    so firing does not walk the tree. Binding to or unbinding from a node, or
+    moving it, only invalidates the caches of the node and its descendants,
+    the nodes whose firings it takes part in. Repeated firings in deep trees
+    cost about the same as firing a single Event.
+
+    Nodes must be destroyed before the EventHierarchy they belong to. Neither
+    is thread safe.
+*/
+template <typename... Args>
+class EventHierarchy
+{
+    public:
+
+        class Node;
+
+        class Dispatch;
+
+        typedef std::function<void(Dispatch&, Args...)> Function;
+
+    private:
+
+        struct Handler
+        {
+            Handler(Node* node, const Function& function):
+                node(node),
+                function(function)
+            {
+            }
+
+            // The node the function is bound to, null once unbound.
+            Node* node;
+
+            Function function;
+        };
+
+        struct Entry
+        {
+            Node* node;
+
+            EventPhase phase;
+
+            std::shared_ptr<Handler> handler;
+        };
+
+        typedef std::vector<Entry> Flattened;
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a Node, the function is
+            unbound when the Bind is destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (this->handler->node)
+                    {
+                        this->handler->node->unbind(this->handler);
+                    }
+                }
+
+            private:
+
+                friend class Node;
+
+                /*
+                    Constructor
+                =============================================================*/
+                explicit Bind(const std::shared_ptr<Handler>& handler):
+                    handler(handler)
+                {
+                }
+
+                std::shared_ptr<Handler> handler;
+        };
+
+        /*
+            The state of a bubbling firing, passed to every function it
+            executes.
+        */
+        class Dispatch
+        {
+            public:
+
+                /*
+                    target
+
+                    The node the firing was made at.
+                =============================================================*/
+                Node& target() const
+                {
+                    return *this->target_node;
+                }
+
+                /*
+                    current
+
+                    The node the executing function is bound to.
+                =============================================================*/
+                Node& current() const
+                {
+                    return *this->current_node;
+                }
+
+                /*
+                    phase
+                =============================================================*/
+                EventPhase phase() const
+                {
+                    return this->current_phase;
+                }
+
+                /*
+                    stop_propagation
+
+                    Executes the remaining functions bound to the current node
+                    in the current phase, but no others.
+                =============================================================*/
+                void stop_propagation()
+                {
+                    this->stopped = true;
+                }
+
+                /*
+                    stop_immediate_propagation
+
+                    Executes no more functions.
+                =============================================================*/
+                void stop_immediate_propagation()
+                {
+                    this->stopped = true;
+                    this->stopped_immediately = true;
+                }
+
+            private:
+
+                friend class EventHierarchy<Args...>;
+
+                explicit Dispatch(Node& target):
+                    target_node(&target),
+                    current_node(&target),
+                    current_phase(EventPhase::capture),
+                    stopped(false),
+                    stopped_immediately(false)
+                {
+                }
+
+                Node* target_node;
+
+                Node* current_node;
+
+                EventPhase current_phase;
+
+                bool stopped;
+
+                bool stopped_immediately;
+        };
+
+        /*
+            A node of the tree, functions are bound to it and firings are made
+            at it.
+        */
+        class Node
+        {
+            public:
+
+                /*
+                    Constructor
+
+                    Creates a node of hierarchy, optionally as a child of
+                    parent.
+                =============================================================*/
+                explicit Node(EventHierarchy& hierarchy, Node* parent = 0):
+                    hierarchy(&hierarchy),
+                    parent_node(0)
+                {
+                    this->set_parent(parent);
+                }
+
+                /*
+                    Destructor
+
+                    Unbinds all functions bound to the node, its children are
+                    left without a parent.
+                =============================================================*/
+                ~Node()
+                {
+                    this->set_parent(0);
+                    for (auto child: this->children)
+                    {
+                        child->parent_node = 0;
+                        child->invalidate();
+                    }
+                    for (auto& handler: this->capture_handlers)
+                    {
+                        handler->node = 0;
+                    }
+                    for (auto& handler: this->bubble_handlers)
+                    {
+                        handler->node = 0;
+                    }
+                }
+
+                /*
+                    parent
+
+                    The parent of the node, null for a root.
+                =============================================================*/
+                Node* parent() const
+                {
+                    return this->parent_node;
+                }
+
+                /*
+                    set_parent
+
+                    Moves the node, along with its descendants, under parent.
+                    A null parent makes the node a root.
+                =============================================================*/
+                void set_parent(Node* parent)
+                {
+                    assert(!parent || parent->hierarchy == this->hierarchy);
+                    if (parent == this->parent_node)
+                    {
+                        return;
+                    }
+                    if (this->parent_node)
+                    {
+                        auto& siblings = this->parent_node->children;
+                        siblings.erase(
+                            std::find(siblings.begin(), siblings.end(), this)
+                        );
+                    }
+                    this->parent_node = parent;
+                    if (parent)
+                    {
+                        parent->children.push_back(this);
+                    }
+                    this->invalidate();
+                }
+
+                /*
+                    bind
+
+                    Binds a function that executes when a firing at the node
+                    or one of its descendants bubbles through the node.
+                =============================================================*/
+                std::shared_ptr<Bind> bind(const Function& function)
+                {
+                    return this->bind(this->bubble_handlers, function);
+                }
+
+                /*
+                    bind_capture
+
+                    Binds a function that executes when a firing at one of the
+                    node's descendants travels down through the node, before
+                    any bubbling functions. Also executes for firings at the
+                    node itself.
+                =============================================================*/
+                std::shared_ptr<Bind> bind_capture(const Function& function)
+                {
+                    return this->bind(this->capture_handlers, function);
+                }
+
+            private:
+
+                friend class EventHierarchy<Args...>;
+
+                friend class Bind;
+
+                Node(const Node&) = delete;
+
+                Node& operator=(const Node&) = delete;
+
+                typedef std::vector<std::shared_ptr<Handler>> Handlers;
+
+                std::shared_ptr<Bind> bind(
+                    Handlers& handlers,
+                    const Function& function
+                )
+                {
+                    auto handler = std::make_shared<Handler>(this, function);
+                    handlers.push_back(handler);
+                    this->invalidate();
+                    return std::shared_ptr<Bind>(new Bind(handler));
+                }
+
+                void unbind(const std::shared_ptr<Handler>& handler)
+                {
+                    handler->node = 0;
+                    if (!remove(this->capture_handlers, handler))
+                    {
+                        remove(this->bubble_handlers, handler);
+                    }
+                    this->invalidate();
+                }
+
+                static bool remove(
+                    Handlers& handlers,
+                    const std::shared_ptr<Handler>& handler
+                )
+                {
+                    auto found = std::find(
+                        handlers.begin(),
+                        handlers.end(),
+                        handler
+                    );
+                    if (found == handlers.end())
+                    {
+                        return false;
+                    }
+                    handlers.erase(found);
+                    return true;
+                }
+
+                // Drops the caches of this node and its descendants, whose
+                // firings pass through it.
+                void invalidate()
+                {
+                    std::vector<Node*> pending(1, this);
+                    while (!pending.empty())
+                    {
+                        auto node = pending.back();
+                        pending.pop_back();
+                        node->cache.reset();
+                        pending.insert(
+                            pending.end(),
+                            node->children.begin(),
+                            node->children.end()
+                        );
+                    }
+                }
+
+                // Returns the functions a firing at this node executes, in
+                // order, rebuilding them if the tree or binds changed.
+                const std::shared_ptr<const Flattened>& flattened()
+                {
+                    if (!this->cache)
+                    {
+                        this->cache = this->flatten();
+                    }
+                    return this->cache;
+                }
+
+                std::shared_ptr<const Flattened> flatten()
+                {
+                    std::vector<Node*> path;
+                    auto node = this->parent_node;
+                    while (node)
+                    {
+                        path.push_back(node);
+                        node = node->parent_node;
+                    }
+                    std::shared_ptr<Flattened> flattened(new Flattened());
+                    for (auto i = path.rbegin(); i != path.rend(); ++i)
+                    {
+                        append(
+                            *flattened,
+                            **i,
+                            (*i)->capture_handlers,
+                            EventPhase::capture
+                        );
+                    }
+                    append(
+                        *flattened,
+                        *this,
+                        this->capture_handlers,
+                        EventPhase::target
+                    );
+                    append(
+                        *flattened,
+                        *this,
+                        this->bubble_handlers,
+                        EventPhase::target
+                    );
+                    for (auto ancestor: path)
+                    {
+                        append(
+                            *flattened,
+                            *ancestor,
+                            ancestor->bubble_handlers,
+                            EventPhase::bubble
+                        );
+                    }
+                    return flattened;
+                }
+
+                static void append(
+                    Flattened& flattened,
+                    Node& node,
+                    const Handlers& handlers,
+                    EventPhase phase
+                )
+                {
+                    for (auto& handler: handlers)
+                    {
+                        Entry entry = {&node, phase, handler};
+                        flattened.push_back(entry);
+                    }
+                }
+
+                EventHierarchy* hierarchy;
+
+                Node* parent_node;
+
+                std::vector<Node*> children;
+
+                Handlers capture_handlers;
+
+                Handlers bubble_handlers;
+
+                // Null when the tree or binds have changed since it was built.
+                std::shared_ptr<const Flattened> cache;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        EventHierarchy()
+        {
+        }
+
+        /*
+            fire_bubbling
+
+            Fires at target: executes the capturing functions of its
+            ancestors from the root down, then the functions bound to target,
+            then the bubbling functions of its ancestors from the parent up,
+            unless one of them stops the propagation. Returns the number of
+            functions executed.
+        =====================================================================*/
+        std::size_t fire_bubbling(Node& target, Args... args)
+        {
+            assert(target.hierarchy == this);
+            // Hold on to the list, binds made by the functions rebuild the
+            // cache rather than change it.
+            auto flattened = target.flattened();
+            Dispatch dispatch(target);
+            std::size_t executed = 0;
+            for (auto& entry: *flattened)
+            {
+                if (dispatch.stopped && (
+                    dispatch.stopped_immediately ||
+                    entry.node != dispatch.current_node ||
+                    entry.phase != dispatch.current_phase
+                ))
+                {
+                    break;
+                }
+                // skip functions unbound during the firing
+                if (!entry.handler->node)
+                {
+                    continue;
+                }
+                dispatch.current_node = entry.node;
+                dispatch.current_phase = entry.phase;
+                entry.handler->function(dispatch, args...);
+                ++executed;
+            }
+            return executed;
+        }
+
+    private:
+
+        EventHierarchy(const EventHierarchy&) = delete;
+
+        EventHierarchy& operator=(const EventHierarchy&) = delete;
+};
+
+#endif
@@ -0,0 +1,369 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_NOEXCEPT_HPP
+#define EVENT_NOEXCEPT_HPP
+
+// standard library
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    An Event whose bound functions may not throw, checked when they are
+    bound. Functions are called through a noexcept call, so firing cannot
+    unwind and the firing loop needs no landing pads or cleanup code. Bound
+    functions execute in the order they were bound and, as with Event, may
+    bind and unbind while the NoexceptEvent is firing. Firing never
+    allocates, the space for functions bound while firing is reserved when
+    they are bound.
+*/
+template <typename... Args>
+class NoexceptEvent
+{
+    private:
+
+        /*
+            A bound function, type erased behind a noexcept call.
+        */
+        struct Handler
+        {
+            Handler():
+                removed(false)
+            {
+            }
+
+            virtual ~Handler()
+            {
+            }
+
+            virtual void call(Args&... args) noexcept = 0;
+
+            bool removed;
+        };
+
+        template <typename Callable>
+        struct BoundHandler final: Handler
+        {
+            explicit BoundHandler(Callable callable):
+                callable(std::move(callable))
+            {
+            }
+
+            void call(Args&... args) noexcept
+            {
+                this->callable(args...);
+            }
+
+            Callable callable;
+        };
+
+        /*
+            The bound functions, shared with the Binds so that they can
+            outlive the NoexceptEvent.
+        */
+        struct State
+        {
+            State():
+                firing(0),
+                dirty(false)
+            {
+            }
+
+            void remove(Handler* handler)
+            {
+                auto found = std::find_if(
+                    this->handlers.begin(),
+                    this->handlers.end(),
+                    [handler](const std::unique_ptr<Handler>& bound){
+                        return bound.get() == handler;
+                    }
+                );
+                if (found == this->handlers.end())
+                {
+                    // bound while firing and not yet executed, or already
+                    // dropped by a destroyed NoexceptEvent
+                    auto pending = std::find_if(
+                        this->pending.begin(),
+                        this->pending.end(),
+                        [handler](const std::unique_ptr<Handler>& bound){
+                            return bound.get() == handler;
+                        }
+                    );
+                    if (pending != this->pending.end())
+                    {
+                        this->pending.erase(pending);
+                    }
+                }
+                else if (this->firing)
+                {
+                    handler->removed = true;
+                    this->dirty = true;
+                }
+                else
+                {
+                    this->handlers.erase(found);
+                }
+            }
+
+            // Called once the outermost firing has finished.
+            void settle()
+            {
+                if (this->dirty)
+                {
+                    this->handlers.erase(
+                        std::remove_if(
+                            this->handlers.begin(),
+                            this->handlers.end(),
+                            [](const std::unique_ptr<Handler>& handler){
+                                return handler->removed;
+                            }
+                        ),
+                        this->handlers.end()
+                    );
+                    this->dirty = false;
+                }
+                // reserved by bind, so this cannot throw
+                assert(
+                    this->handlers.capacity() >=
+                    this->handlers.size() + this->pending.size()
+                );
+                for (auto& handler: this->pending)
+                {
+                    this->handlers.push_back(std::move(handler));
+                }
+                this->pending.clear();
+            }
+
+            std::vector<std::unique_ptr<Handler>> handlers;
+
+            // Functions bound while firing, so that the count being fired
+            // stays put.
+            std::vector<std::unique_ptr<Handler>> pending;
+
+            std::size_t firing;
+
+            bool dirty;
+
+            // Set when the NoexceptEvent is destroyed while firing, the last
+            // firing lets go of it.
+            std::shared_ptr<State> self;
+        };
+
+        /*
+            Marks a State as firing for the lifetime of the Firing.
+        */
+        class Firing
+        {
+            public:
+
+                explicit Firing(State& state) noexcept:
+                    state(state)
+                {
+                    ++this->state.firing;
+                }
+
+                ~Firing()
+                {
+                    if (--this->state.firing)
+                    {
+                        return;
+                    }
+                    if (this->state.self)
+                    {
+                        // destroys the State last
+                        auto self = std::move(this->state.self);
+                        return;
+                    }
+                    this->state.settle();
+                }
+
+            private:
+
+                State& state;
+        };
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a NoexceptEvent, the
+            function is unbound when the Bind is destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (auto state = this->state.lock())
+                    {
+                        state->remove(this->handler);
+                    }
+                }
+
+            private:
+
+                friend class NoexceptEvent<Args...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(const std::shared_ptr<State>& state, Handler* handler):
+                    state(state),
+                    handler(handler)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                Handler* handler;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        NoexceptEvent():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~NoexceptEvent()
+        {
+            if (this->state->firing)
+            {
+                for (auto& handler: this->state->handlers)
+                {
+                    handler->removed = true;
+                }
+                this->state->pending.clear();
+                this->state->self = std::move(this->state);
+            }
+        }
+
+        /*
+            bind
+
+            Binds callable, which must be noexcept when called with the
+            arguments of the NoexceptEvent, for the duration of the Bind
+            returned.
+        =====================================================================*/
+        template <typename Callable>
+        std::shared_ptr<Bind> bind(Callable callable)
+        {
+            static_assert(
+                noexcept(std::declval<Callable&>()(std::declval<Args&>()...)),
+                "functions bound to a NoexceptEvent must be noexcept"
+            );
+            std::unique_ptr<Handler> handler(
+                new BoundHandler<Callable>(std::move(callable))
+            );
+            auto bound = handler.get();
+            auto& state = *this->state;
+            if (state.firing)
+            {
+                // Settling moves the pending functions into handlers when
+                // the firing ends and must not allocate there, fire is
+                // noexcept. Firing indexes handlers afresh for every
+                // function, so growing it here is safe.
+                auto needed = state.handlers.size() + state.pending.size() + 1;
+                if (state.handlers.capacity() < needed)
+                {
+                    state.handlers.reserve(
+                        std::max(needed, 2 * state.handlers.capacity())
+                    );
+                }
+                state.pending.push_back(std::move(handler));
+            }
+            else
+            {
+                state.handlers.push_back(std::move(handler));
+            }
+            return std::shared_ptr<Bind>(new Bind(this->state, bound));
+        }
+
+        /*
+            has_handlers
+
+            Returns true if at least one function is bound.
+        =====================================================================*/
+        bool has_handlers() const
+        {
+            for (auto& handler: this->state->handlers)
+            {
+                if (!handler->removed)
+                {
+                    return true;
+                }
+            }
+            return !this->state->pending.empty();
+        }
+
+        /*
+            fire
+
+            Executes all bound functions using the arguments provided. Returns
+            the number of functions executed.
+        =====================================================================*/
+        std::size_t fire(Args... args) noexcept
+        {
+            auto& state = *this->state;
+            Firing firing(state);
+            std::size_t executed = 0;
+            // functions bound while firing wait in pending, so the count
+            // and the array stay put
+            auto count = state.handlers.size();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto handler = state.handlers[i].get();
+                if (!handler->removed)
+                {
+                    handler->call(args...);
+                    ++executed;
+                }
+            }
+            return executed;
+        }
+
+    private:
+
+        NoexceptEvent(const NoexceptEvent&) = delete;
+
+        NoexceptEvent& operator=(const NoexceptEvent&) = delete;
+
+        std::shared_ptr<State> state;
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_REALTIME_HPP
+#define EVENT_REALTIME_HPP
+
+// standard library
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    An Event for firing from a realtime thread, such as an audio callback,
+    while functions are bound and unbound from other threads.
+
+    fire is wait-free: it never locks, allocates or frees memory, so it can
+    not be held up by the threads that bind. Binding and unbinding build a new
+    immutable list of functions and publish it with a single atomic store.
+    The list it replaces, along with any unbound function, is freed by the
+    thread that made the change once the realtime thread is no longer firing
+    with it.
+
+    Only one thread may fire at a time. Functions must not bind or unbind
+    (destroy a Bind) from within a firing, as unbinding waits for the firing
+    to finish.
+*/
+template <typename... Args>
+class RealtimeEvent
+{
+    public:
+
+        typedef std::function<void(Args...)> Function;
+
+    private:
+
+        struct Handler
+        {
+            explicit Handler(const Function& function):
+                function(function)
+            {
+            }
+
+            Function function;
+        };
+
+        // The functions executed by a firing, never changed once
+        // published.
+        struct Snapshot
+        {
+            std::vector<Handler*> handlers;
+        };
+
+        struct State
+        {
+            State():
+                current(0),
+                epoch(0)
+            {
+            }
+
+            ~State()
+            {
+                delete this->current.load();
+            }
+
+            Handler* bind(const Function& function)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                std::unique_ptr<Handler> handler(new Handler(function));
+                this->handlers.push_back(std::move(handler));
+                this->publish();
+                return this->handlers.back().get();
+            }
+
+            void unbind(Handler* handler)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                auto found = std::find_if(
+                    this->handlers.begin(),
+                    this->handlers.end(),
+                    [handler](const std::unique_ptr<Handler>& bound){
+                        return bound.get() == handler;
+                    }
+                );
+                std::unique_ptr<Handler> removed(std::move(*found));
+                this->handlers.erase(found);
+                // removed is freed after publish has waited for the
+                // firings that could still be executing it
+                this->publish();
+            }
+
+            // Replaces the published snapshot with one of the current
+            // handlers, then frees the old one once no firing uses it.
+            void publish()
+            {
+                Snapshot* snapshot = 0;
+                if (!this->handlers.empty())
+                {
+                    snapshot = new Snapshot();
+                    snapshot->handlers.reserve(this->handlers.size());
+                    for (auto& handler: this->handlers)
+                    {
+                        snapshot->handlers.push_back(handler.get());
+                    }
+                }
+                std::unique_ptr<Snapshot> old(this->current.exchange(snapshot));
+                this->synchronize();
+            }
+
+            // Waits until any firing that may have loaded the previous
+            // snapshot has finished. The epoch is odd while firing.
+            void synchronize()
+            {
+                auto epoch = this->epoch.load();
+                if (epoch % 2 == 0)
+                {
+                    return;
+                }
+                while (this->epoch.load() == epoch)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            // Guards the handlers, only taken by binding threads.
+            std::mutex mutex;
+
+            std::vector<std::unique_ptr<Handler>> handlers;
+
+            std::atomic<Snapshot*> current;
+
+            std::atomic<std::uint64_t> epoch;
+        };
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a RealtimeEvent, the
+            function is unbound when the Bind is destroyed. Once the
+            destructor returns the function is not executing and will not be
+            executed again.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (auto state = this->state.lock())
+                    {
+                        state->unbind(this->handler);
+                    }
+                }
+
+            private:
+
+                friend class RealtimeEvent<Args...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(const std::shared_ptr<State>& state, Handler* handler):
+                    state(state),
+                    handler(handler)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                Handler* handler;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        RealtimeEvent():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            is_lock_free
+
+            Returns true if firing is free of locks on this platform, which
+            requires the atomics it uses to be lock free.
+        =====================================================================*/
+        bool is_lock_free() const
+        {
+            return (
+                this->state->current.is_lock_free() &&
+                this->state->epoch.is_lock_free()
+            );
+        }
+
+        /*
+            bind
+
+            Binds a function to the RealtimeEvent for the duration of the Bind
+            returned. Must not be called from the firing thread.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(const Function& function)
+        {
+            auto handler = this->state->bind(function);
+            return std::shared_ptr<Bind>(new Bind(this->state, handler));
+        }
+
+        /*
+            has_handlers
+
+            Returns true if at least one function is bound to the
+            RealtimeEvent. Wait-free.
+        =====================================================================*/
+        bool has_handlers() const
+        {
+            return this->state->current.load() != 0;
+        }
+
+        /*
+            fire
+
+            Executes all bound functions using the arguments provided. Wait-
+            free, neither locks nor allocates. Returns the number of functions
+            executed.
+        =====================================================================*/
+        std::size_t fire(Args... args)
+        {
+            auto& state = *this->state;
+            Firing firing(state);
+            auto snapshot = state.current.load();
+            if (!snapshot)
+            {
+                return 0;
+            }
+            for (auto handler: snapshot->handlers)
+            {
+                handler->function(args...);
+            }
+            return snapshot->handlers.size();
+        }
+
+    private:
+
+        RealtimeEvent(const RealtimeEvent&) = delete;
+
+        RealtimeEvent& operator=(const RealtimeEvent&) = delete;
+
+        /*
+            Makes the epoch odd for the lifetime of the Firing, so that
+            binding threads know to wait before freeing what it may use.
+        */
+        class Firing
+        {
+            public:
+
+                explicit Firing(State& state):
+                    state(state)
+                {
+                    this->state.epoch.fetch_add(1);
+                }
+
+                ~Firing()
+                {
+                    this->state.epoch.fetch_add(1);
+                }
+
+            private:
+
+                State& state;
+        };
+
+        std::shared_ptr<State> state;
+};
+
+#endif
@@ -0,0 +1,519 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_RECORD_HPP
+#define EVENT_RECORD_HPP
+
+// standard library
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+// posix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// event
+#include "event.hpp"
+#include "event_codec.hpp"
+
+/*
+    The on disk layout shared by EventRecorder and EventReplayer.
+
+    A log is a series of segment files named "<path>.<index>", where index is
+    an eight digit decimal number starting at 0. Each segment begins with a
+    fixed size header followed by tightly packed records:
+
+        header: magic[8] version:u32 schema:u32 end:u64
+        record: delta:varint size:varint payload[size]
+
+    "end" is the offset one past the last complete record. It is rewritten
+    after every append so that a segment left behind by a crashed process can
+    still be replayed. "delta" is the number of nanoseconds between a record
+    and the one before it (or the start of the recording).
+*/
+namespace event_detail
+{
+    const std::size_t event_log_header_size = 24;
+
+    const std::uint32_t event_log_version = 1;
+
+    const char event_log_magic[8] = {'E', 'V', 'E', 'N', 'T', 'L', 'O', 'G'};
+
+    inline std::string event_log_segment_path(
+        const std::string& path,
+        std::size_t index
+    )
+    {
+        char suffix[32];
+        std::snprintf(
+            suffix,
+            sizeof(suffix),
+            ".%08llu",
+            static_cast<unsigned long long>(index)
+        );
+        return path + suffix;
+    }
+
+    inline void event_log_throw_errno(const std::string& what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    /*
+        A cheap fingerprint of an argument list so that a log can not be
+        replayed into an Event with a different signature.
+    */
+    template <typename... Args>
+    std::uint32_t event_log_schema()
+    {
+        const std::size_t sizes[] = {
+            sizeof...(Args),
+            sizeof(typename std::decay<Args>::type)...
+        };
+        std::uint32_t hash = 2166136261u;
+        for (auto size: sizes)
+        {
+            hash = (hash ^ static_cast<std::uint32_t>(size)) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+/*
+    Records every firing of an Event to a segmented, memory mapped append log
+    for the lifetime of the EventRecorder. Recording is opt-in: an Event pays
+    nothing until a recorder is attached to it.
+
+    Arguments are stored with EventCodec, so every argument type must have
+    EventCodecTraits.
+*/
+template <typename... Args>
+class EventRecorder
+{
+    public:
+
+        /*
+            Constructor
+
+            Any segments left over from a previous recording at the same path
+            are removed. segment_size is the size each segment file is
+            preallocated to before being mapped.
+        =====================================================================*/
+        EventRecorder(
+            Event<Args...>& event,
+            const std::string& path,
+            std::size_t segment_size = 64 * 1024 * 1024
+        ):
+            path(path),
+            segment_size(segment_size),
+            segment_index(0),
+            file(-1),
+            data(0),
+            capacity(0),
+            end(0),
+            records(0),
+            start(std::chrono::steady_clock::now()),
+            last(0)
+        {
+            for(std::size_t i = 0;; ++i)
+            {
+                auto segment = event_detail::event_log_segment_path(path, i);
+                if (unlink(segment.c_str()) != 0)
+                {
+                    break;
+                }
+            }
+            this->open_segment(0);
+            this->bind = event.bind([this](Args... args){
+                this->record(args...);
+            });
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~EventRecorder()
+        {
+            this->bind = 0;
+            this->close_segment();
+        }
+
+        /*
+            record_count
+
+            The number of firings recorded so far.
+        =====================================================================*/
+        std::size_t record_count() const
+        {
+            return this->records;
+        }
+
+        /*
+            segment_count
+
+            The number of segment files written so far.
+        =====================================================================*/
+        std::size_t segment_count() const
+        {
+            return this->segment_index + 1;
+        }
+
+    private:
+
+        EventRecorder(const EventRecorder&) = delete;
+
+        EventRecorder& operator=(const EventRecorder&) = delete;
+
+        void record(Args... args)
+        {
+            auto now = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - this->start
+                ).count()
+            );
+            auto payload_size = EventCodec<Args...>::size(args...);
+            auto record_size = (
+                event_detail::varint_size(now - this->last) +
+                event_detail::varint_size(payload_size) +
+                payload_size
+            );
+            if (this->end + record_size > this->capacity)
+            {
+                this->close_segment();
+                this->open_segment(this->segment_index + 1, record_size);
+            }
+
+            auto out = this->data + this->end;
+            event_detail::put_varint(out, now - this->last);
+            event_detail::put_varint(out, payload_size);
+            EventCodec<Args...>::encode(out, args...);
+
+            this->end += record_size;
+            this->last = now;
+            ++this->records;
+            std::uint64_t end = this->end;
+            std::memcpy(this->data + 16, &end, sizeof(end));
+        }
+
+        void open_segment(std::size_t index, std::size_t minimum = 0)
+        {
+            auto segment = event_detail::event_log_segment_path(
+                this->path,
+                index
+            );
+            this->file = open(
+                segment.c_str(),
+                O_RDWR | O_CREAT | O_TRUNC,
+                0644
+            );
+            if (this->file < 0)
+            {
+                event_detail::event_log_throw_errno(segment);
+            }
+            this->capacity = std::max(
+                this->segment_size,
+                event_detail::event_log_header_size + minimum
+            );
+            if (ftruncate(this->file, this->capacity) != 0)
+            {
+                close(this->file);
+                this->file = -1;
+                event_detail::event_log_throw_errno(segment);
+            }
+            auto mapping = mmap(
+                0,
+                this->capacity,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                this->file,
+                0
+            );
+            if (mapping == MAP_FAILED)
+            {
+                close(this->file);
+                this->file = -1;
+                event_detail::event_log_throw_errno(segment);
+            }
+            madvise(mapping, this->capacity, MADV_SEQUENTIAL);
+            this->data = static_cast<unsigned char*>(mapping);
+            this->segment_index = index;
+            this->end = event_detail::event_log_header_size;
+
+            std::uint32_t version = event_detail::event_log_version;
+            std::uint32_t schema = event_detail::event_log_schema<Args...>();
+            std::uint64_t end = this->end;
+            std::memcpy(this->data, event_detail::event_log_magic, 8);
+            std::memcpy(this->data + 8, &version, sizeof(version));
+            std::memcpy(this->data + 12, &schema, sizeof(schema));
+            std::memcpy(this->data + 16, &end, sizeof(end));
+        }
+
+        void close_segment()
+        {
+            if (this->data)
+            {
+                munmap(this->data, this->capacity);
+                this->data = 0;
+            }
+            if (this->file >= 0)
+            {
+                // Give back the unused tail of the preallocated segment.
+                auto result = ftruncate(this->file, this->end);
+                (void)result;
+                close(this->file);
+                this->file = -1;
+            }
+        }
+
+        std::string path;
+
+        std::size_t segment_size;
+
+        std::size_t segment_index;
+
+        int file;
+
+        unsigned char* data;
+
+        std::size_t capacity;
+
+        std::size_t end;
+
+        std::size_t records;
+
+        std::chrono::steady_clock::time_point start;
+
+        std::uint64_t last;
+
+        std::shared_ptr<typename Event<Args...>::Bind> bind;
+};
+
+/*
+    How EventReplayer paces the firings it replays.
+*/
+enum class EventReplayPacing
+{
+    // Fire every record back to back.
+    as_fast_as_possible,
+    // Wait between records so that they are fired with the spacing they were
+    // recorded with.
+    recorded
+};
+
+/*
+    Replays a log written by EventRecorder by firing each record into an
+    Event.
+
+    Segments are mapped one at a time and read strictly front to back. Pages
+    that have been replayed are handed back to the kernel as the replay
+    progresses so that logs much larger than memory can be replayed.
+*/
+template <typename... Args>
+class EventReplayer
+{
+    public:
+
+        /*
+            Constructor
+        =====================================================================*/
+        explicit EventReplayer(const std::string& path):
+            path(path)
+        {
+        }
+
+        /*
+            replay
+
+            Fires every recorded record into event, returns the number of
+            records fired.
+        =====================================================================*/
+        std::size_t replay(
+            Event<Args...>& event,
+            EventReplayPacing pacing = EventReplayPacing::as_fast_as_possible
+        ) const
+        {
+            std::size_t records = 0;
+            std::uint64_t timestamp = 0;
+            auto start = std::chrono::steady_clock::now();
+            for(std::size_t i = 0;; ++i)
+            {
+                auto segment = event_detail::event_log_segment_path(
+                    this->path,
+                    i
+                );
+                auto file = open(segment.c_str(), O_RDONLY);
+                if (file < 0)
+                {
+                    if (errno == ENOENT && i > 0)
+                    {
+                        break;
+                    }
+                    event_detail::event_log_throw_errno(segment);
+                }
+                try
+                {
+                    records += this->replay_segment(
+                        file,
+                        event,
+                        pacing,
+                        start,
+                        timestamp
+                    );
+                }
+                catch (...)
+                {
+                    close(file);
+                    throw;
+                }
+                close(file);
+            }
+            return records;
+        }
+
+    private:
+
+        // The amount of the log mapped ahead of, and released behind, the
+        // replay position.
+        static const std::size_t window = 4 * 1024 * 1024;
+
+        std::size_t replay_segment(
+            int file,
+            Event<Args...>& event,
+            EventReplayPacing pacing,
+            std::chrono::steady_clock::time_point start,
+            std::uint64_t& timestamp
+        ) const
+        {
+            struct stat status;
+            if (fstat(file, &status) != 0)
+            {
+                event_detail::event_log_throw_errno(this->path);
+            }
+            std::size_t size = static_cast<std::size_t>(status.st_size);
+            if (size < event_detail::event_log_header_size)
+            {
+                throw std::runtime_error("event log: truncated segment");
+            }
+            auto mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (mapping == MAP_FAILED)
+            {
+                event_detail::event_log_throw_errno(this->path);
+            }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+
+            auto data = static_cast<const unsigned char*>(mapping);
+            std::uint32_t version;
+            std::uint32_t schema;
+            std::uint64_t end;
+            std::memcpy(&version, data + 8, sizeof(version));
+            std::memcpy(&schema, data + 12, sizeof(schema));
+            std::memcpy(&end, data + 16, sizeof(end));
+            if (
+                std::memcmp(data, event_detail::event_log_magic, 8) != 0 ||
+                version != event_detail::event_log_version ||
+                schema != event_detail::event_log_schema<Args...>() ||
+                end > size
+            )
+            {
+                munmap(mapping, size);
+                throw std::runtime_error("event log: incompatible segment");
+            }
+
+            std::size_t page_size = sysconf(_SC_PAGESIZE);
+            std::size_t released = 0;
+            std::size_t prefetched = 0;
+            std::size_t records = 0;
+            auto in = data + event_detail::event_log_header_size;
+            auto in_end = data + end;
+            try
+            {
+                while (in < in_end)
+                {
+                    std::size_t offset = in - data;
+                    if (offset >= prefetched)
+                    {
+                        prefetched = std::min<std::size_t>(
+                            (offset / page_size) * page_size + window,
+                            size
+                        );
+                        madvise(
+                            const_cast<unsigned char*>(data) +
+                                (offset / page_size) * page_size,
+                            prefetched - (offset / page_size) * page_size,
+                            MADV_WILLNEED
+                        );
+                    }
+                    if (offset - released >= window)
+                    {
+                        auto release = (offset / page_size) * page_size;
+                        madvise(
+                            const_cast<unsigned char*>(data) + released,
+                            release - released,
+                            MADV_DONTNEED
+                        );
+                        released = release;
+                    }
+
+                    timestamp += event_detail::get_varint(in, in_end);
+                    auto payload_size = event_detail::get_varint(in, in_end);
+                    if (payload_size > static_cast<std::size_t>(in_end - in))
+                    {
+                        throw std::runtime_error("event log: truncated record");
+                    }
+                    if (pacing == EventReplayPacing::recorded)
+                    {
+                        std::this_thread::sleep_until(
+                            start + std::chrono::nanoseconds(timestamp)
+                        );
+                    }
+                    EventCodec<Args...>::fire(event, in, in + payload_size);
+                    in += payload_size;
+                    ++records;
+                }
+            }
+            catch (...)
+            {
+                munmap(mapping, size);
+                throw;
+            }
+            munmap(mapping, size);
+            return records;
+        }
+
+        std::string path;
+};
+
+#endif
@@ -0,0 +1,934 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_ROUTE_HPP
+#define EVENT_ROUTE_HPP
+
+// standard library
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace event_detail
+{
+    /*
+        RouteHash
+
+        Hashes the values of a RoutedEvent field, std::hash is not required
+        to support enumerations before C++14.
+    */
+    template <typename T, bool Enum = std::is_enum<T>::value>
+    struct RouteHash: std::hash<T>
+    {
+    };
+
+    template <typename T>
+    struct RouteHash<T, true>
+    {
+        std::size_t operator()(T value) const
+        {
+            typedef typename std::underlying_type<T>::type Underlying;
+            return std::hash<Underlying>()(static_cast<Underlying>(value));
+        }
+    };
+
+    /*
+        IsRouteHashable
+
+        True if T can key a hash table hashed with RouteHash.
+    */
+    template <typename T, typename Enable = void>
+    struct IsRouteHashable: std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsRouteHashable<
+        T,
+        typename std::enable_if<
+            std::is_convertible<
+                decltype(RouteHash<T>()(std::declval<const T&>())),
+                std::size_t
+            >::value &&
+            std::is_convertible<
+                decltype(std::declval<const T&>() == std::declval<const T&>()),
+                bool
+            >::value
+        >::type
+    >: std::true_type
+    {
+    };
+
+    /*
+        IsRouteOrdered
+
+        True if T is less than comparable.
+    */
+    template <typename T, typename Enable = void>
+    struct IsRouteOrdered: std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsRouteOrdered<
+        T,
+        typename std::enable_if<
+            std::is_convertible<
+                decltype(std::declval<const T&>() < std::declval<const T&>()),
+                bool
+            >::value
+        >::type
+    >: std::true_type
+    {
+    };
+
+    /*
+        RouteEqualIndex
+
+        Maps the values of equality tests on a RoutedEvent field to the slots
+        that made them, in a hash table when T is hashable and in an ordered
+        map otherwise.
+    */
+    template <typename T, bool Hashable = IsRouteHashable<T>::value>
+    struct RouteEqualIndex
+    {
+        typedef std::unordered_map<
+            T,
+            std::vector<std::size_t>,
+            RouteHash<T>
+        > type;
+    };
+
+    template <typename T>
+    struct RouteEqualIndex<T, false>
+    {
+        typedef std::map<T, std::vector<std::size_t>> type;
+    };
+}
+
+/*
+    An Event whose functions are bound with a filter over fields of the
+    message, such as side == Side::buy && quantity > 1000, and only execute
+    for the messages that pass it.
+
+    The filters are not evaluated one function at a time. Each field keeps an
+    index of the tests made against it, equality tests in a hash table keyed
+    by value and range tests in arrays sorted by bound. A firing projects
+    each field once, looks its value up in the index and counts the tests
+    passed by each function, so a test shared by many functions is evaluated
+    once. The indexes are updated as functions are bound and unbound.
+
+    Equality tests need a field that is hashable and equality comparable, or
+    failing that less than comparable, in which case the values are kept in
+    an ordered map. Range tests need a field that is less than comparable.
+    Each kind of test is only required of the fields it is made against.
+*/
+template <typename Message>
+class RoutedEvent
+{
+    public:
+
+        typedef std::function<void(const Message&)> Function;
+
+    private:
+
+        struct State;
+
+        enum class Test
+        {
+            equal,
+            greater,
+            greater_equal,
+            less,
+            less_equal
+        };
+
+        /*
+            The tests made against one field.
+        */
+        struct FieldIndex
+        {
+            virtual ~FieldIndex()
+            {
+            }
+
+            // Counts the tests message passes for each function.
+            virtual void match(const Message& message, State& state) = 0;
+        };
+
+        template <typename T>
+        struct TypedFieldIndex final: FieldIndex
+        {
+            typedef std::vector<std::pair<T, std::size_t>> Bounds;
+
+            explicit TypedFieldIndex(std::function<T(const Message&)> project):
+                project(std::move(project)),
+                tests(0)
+            {
+            }
+
+            // The equality and range tests are kept apart so that a field
+            // only needs to support the kinds of tests made against it.
+            typedef std::integral_constant<
+                bool,
+                event_detail::IsRouteHashable<T>::value ||
+                event_detail::IsRouteOrdered<T>::value
+            > CanEqual;
+
+            typedef event_detail::IsRouteOrdered<T> CanBound;
+
+            void add_equal(const T& value, std::size_t slot)
+            {
+                this->equal[value].push_back(slot);
+                ++this->tests;
+            }
+
+            void remove_equal(const T& value, std::size_t slot)
+            {
+                auto bucket = this->equal.find(value);
+                assert(bucket != this->equal.end());
+                auto& slots = bucket->second;
+                slots.erase(std::find(slots.begin(), slots.end(), slot));
+                if (slots.empty())
+                {
+                    this->equal.erase(bucket);
+                }
+                --this->tests;
+            }
+
+            void add_bound(Test test, const T& value, std::size_t slot)
+            {
+                auto& bounds = this->bounds(test);
+                // ties stay in the order they were added
+                bounds.emplace(this->upper_bound(bounds, value), value, slot);
+                ++this->tests;
+            }
+
+            void remove_bound(Test test, const T& value, std::size_t slot)
+            {
+                auto& bounds = this->bounds(test);
+                bounds.erase(std::find_if(
+                    this->lower_bound(bounds, value),
+                    bounds.end(),
+                    [slot](const std::pair<T, std::size_t>& bound){
+                        return bound.second == slot;
+                    }
+                ));
+                --this->tests;
+            }
+
+            void match(const Message& message, State& state)
+            {
+                if (!this->tests)
+                {
+                    return;
+                }
+                auto value = this->project(message);
+                this->match_equal(value, state, CanEqual());
+                this->match_bounds(value, state, CanBound());
+            }
+
+            void match_equal(const T& value, State& state, std::true_type)
+            {
+                if (this->equal.empty())
+                {
+                    return;
+                }
+                auto bucket = this->equal.find(value);
+                if (bucket != this->equal.end())
+                {
+                    for (auto slot: bucket->second)
+                    {
+                        state.pass(slot);
+                    }
+                }
+            }
+
+            void match_equal(const T&, State&, std::false_type)
+            {
+            }
+
+            void match_bounds(const T& value, State& state, std::true_type)
+            {
+                // bounds below value
+                this->pass(
+                    state,
+                    this->greater.begin(),
+                    this->lower_bound(this->greater, value)
+                );
+                this->pass(
+                    state,
+                    this->greater_equal.begin(),
+                    this->upper_bound(this->greater_equal, value)
+                );
+                // bounds above value
+                this->pass(
+                    state,
+                    this->upper_bound(this->less, value),
+                    this->less.end()
+                );
+                this->pass(
+                    state,
+                    this->lower_bound(this->less_equal, value),
+                    this->less_equal.end()
+                );
+            }
+
+            void match_bounds(const T&, State&, std::false_type)
+            {
+            }
+
+            Bounds& bounds(Test test)
+            {
+                switch (test)
+                {
+                    case Test::greater:
+                        return this->greater;
+                    case Test::greater_equal:
+                        return this->greater_equal;
+                    case Test::less:
+                        return this->less;
+                    default:
+                        assert(test == Test::less_equal);
+                        return this->less_equal;
+                }
+            }
+
+            static typename Bounds::iterator lower_bound(
+                Bounds& bounds,
+                const T& value
+            )
+            {
+                return std::lower_bound(
+                    bounds.begin(),
+                    bounds.end(),
+                    value,
+                    [](const std::pair<T, std::size_t>& bound, const T& value){
+                        return bound.first < value;
+                    }
+                );
+            }
+
+            static typename Bounds::iterator upper_bound(
+                Bounds& bounds,
+                const T& value
+            )
+            {
+                return std::upper_bound(
+                    bounds.begin(),
+                    bounds.end(),
+                    value,
+                    [](const T& value, const std::pair<T, std::size_t>& bound){
+                        return value < bound.first;
+                    }
+                );
+            }
+
+            static void pass(
+                State& state,
+                typename Bounds::iterator begin,
+                typename Bounds::iterator end
+            )
+            {
+                for (; begin != end; ++begin)
+                {
+                    state.pass(begin->second);
+                }
+            }
+
+            std::function<T(const Message&)> project;
+
+            typename event_detail::RouteEqualIndex<T>::type equal;
+
+            Bounds greater;
+
+            Bounds greater_equal;
+
+            Bounds less;
+
+            Bounds less_equal;
+
+            // The number of tests in the index.
+            std::size_t tests;
+        };
+
+        /*
+            One test of a filter, which adds itself to and removes itself
+            from the index of its field.
+        */
+        struct Condition
+        {
+            virtual ~Condition()
+            {
+            }
+
+            virtual void add(std::size_t slot) = 0;
+
+            virtual void remove(std::size_t slot) = 0;
+        };
+
+        template <typename T>
+        struct EqualCondition final: Condition
+        {
+            EqualCondition(TypedFieldIndex<T>& index, T value):
+                index(index),
+                value(std::move(value))
+            {
+            }
+
+            void add(std::size_t slot)
+            {
+                this->index.add_equal(this->value, slot);
+            }
+
+            void remove(std::size_t slot)
+            {
+                this->index.remove_equal(this->value, slot);
+            }
+
+            TypedFieldIndex<T>& index;
+
+            T value;
+        };
+
+        template <typename T>
+        struct BoundCondition final: Condition
+        {
+            BoundCondition(TypedFieldIndex<T>& index, Test test, T value):
+                index(index),
+                test(test),
+                value(std::move(value))
+            {
+            }
+
+            void add(std::size_t slot)
+            {
+                this->index.add_bound(this->test, this->value, slot);
+            }
+
+            void remove(std::size_t slot)
+            {
+                this->index.remove_bound(this->test, this->value, slot);
+            }
+
+            TypedFieldIndex<T>& index;
+
+            Test test;
+
+            T value;
+        };
+
+    public:
+
+        /*
+            A conjunction of tests on fields, made by comparing Fields with
+            values and combining the results with &&. A default constructed
+            Filter passes every message.
+        */
+        class Filter
+        {
+            public:
+
+                friend Filter operator&&(Filter left, const Filter& right)
+                {
+                    left.conditions.insert(
+                        left.conditions.end(),
+                        right.conditions.begin(),
+                        right.conditions.end()
+                    );
+                    return left;
+                }
+
+            private:
+
+                friend class RoutedEvent<Message>;
+
+                std::vector<std::shared_ptr<Condition>> conditions;
+        };
+
+        /*
+            A projection of the message registered with a RoutedEvent by
+            field, compared with values to make Filters. Only valid for the
+            lifetime of the RoutedEvent.
+        */
+        template <typename T>
+        class Field
+        {
+            public:
+
+                typedef T Value;
+
+                friend Filter operator==(const Field& field, const T& value)
+                {
+                    static_assert(
+                        TypedFieldIndex<T>::CanEqual::value,
+                        "equality tests need a field that is hashable and "
+                        "equality comparable, or less than comparable"
+                    );
+                    return field.make(
+                        std::make_shared<EqualCondition<T>>(
+                            *field.index,
+                            value
+                        )
+                    );
+                }
+
+                friend Filter operator>(const Field& field, const T& value)
+                {
+                    return field.make_bound(Test::greater, value);
+                }
+
+                friend Filter operator>=(const Field& field, const T& value)
+                {
+                    return field.make_bound(Test::greater_equal, value);
+                }
+
+                friend Filter operator<(const Field& field, const T& value)
+                {
+                    return field.make_bound(Test::less, value);
+                }
+
+                friend Filter operator<=(const Field& field, const T& value)
+                {
+                    return field.make_bound(Test::less_equal, value);
+                }
+
+            private:
+
+                friend class RoutedEvent<Message>;
+
+                explicit Field(TypedFieldIndex<T>& index):
+                    index(&index)
+                {
+                }
+
+                Filter make_bound(Test test, const T& value) const
+                {
+                    static_assert(
+                        TypedFieldIndex<T>::CanBound::value,
+                        "range tests need a field that is less than comparable"
+                    );
+                    return this->make(
+                        std::make_shared<BoundCondition<T>>(
+                            *this->index,
+                            test,
+                            value
+                        )
+                    );
+                }
+
+                Filter make(std::shared_ptr<Condition> condition) const
+                {
+                    Filter filter;
+                    filter.conditions.push_back(std::move(condition));
+                    return filter;
+                }
+
+                TypedFieldIndex<T>* index;
+        };
+
+        /*
+            An object that has ownership of a bind to a RoutedEvent, the
+            function is unbound when the Bind is destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (auto state = this->state.lock())
+                    {
+                        state->unbind(this->slot);
+                    }
+                }
+
+            private:
+
+                friend class RoutedEvent<Message>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(const std::shared_ptr<State>& state, std::size_t slot):
+                    state(state),
+                    slot(slot)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                std::size_t slot;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        RoutedEvent():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~RoutedEvent()
+        {
+            auto& state = *this->state;
+            if (state.firing)
+            {
+                for (std::size_t slot = 0; slot < state.bound.size(); ++slot)
+                {
+                    if (state.bound[slot])
+                    {
+                        state.unbind(slot);
+                    }
+                }
+                this->state->self = std::move(this->state);
+            }
+        }
+
+        /*
+            field
+
+            Registers the member of the message pointed to by member as a
+            field to filter on.
+        =====================================================================*/
+        template <typename T>
+        Field<T> field(T Message::* member)
+        {
+            return this->field([member](const Message& message){
+                return message.*member;
+            });
+        }
+
+        /*
+            field
+
+            Registers the result of project, called with the message, as a
+            field to filter on. It is called at most once per firing.
+        =====================================================================*/
+        template <
+            typename Projection,
+            typename T = typename std::decay<decltype(
+                std::declval<Projection&>()(std::declval<const Message&>())
+            )>::type
+        >
+        Field<T> field(Projection project)
+        {
+            std::unique_ptr<TypedFieldIndex<T>> index(
+                new TypedFieldIndex<T>(std::move(project))
+            );
+            Field<T> field(*index);
+            this->state->fields.push_back(std::move(index));
+            return field;
+        }
+
+        /*
+            bind
+
+            Binds a function that executes for the messages that pass filter,
+            for the duration of the Bind returned.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(
+            const Filter& filter,
+            const Function& function
+        )
+        {
+            auto slot = this->state->bind(filter, function);
+            return std::shared_ptr<Bind>(new Bind(this->state, slot));
+        }
+
+        /*
+            has_handlers
+
+            Returns true if at least one function is bound.
+        =====================================================================*/
+        bool has_handlers() const
+        {
+            return this->state->live != 0;
+        }
+
+        /*
+            fire
+
+            Executes the functions whose filter message passes, in the order
+            they were bound. Returns the number of functions executed.
+        =====================================================================*/
+        std::size_t fire(const Message& message)
+        {
+            auto& state = *this->state;
+            if (!state.live)
+            {
+                return 0;
+            }
+            Firing firing(state);
+            ++state.generation;
+            for (auto& field: state.fields)
+            {
+                field->match(message, state);
+            }
+            // the scratch space is taken for the rest of the firing, a
+            // nested firing makes its own
+            std::vector<std::size_t> passed;
+            passed.swap(state.passed);
+            passed.insert(
+                passed.end(),
+                state.unfiltered.begin(),
+                state.unfiltered.end()
+            );
+            std::sort(
+                passed.begin(),
+                passed.end(),
+                [&state](std::size_t a, std::size_t b){
+                    return state.order[a] < state.order[b];
+                }
+            );
+            std::size_t executed = 0;
+            // functions bound while firing are not in passed, functions
+            // unbound while firing are skipped
+            for (auto slot: passed)
+            {
+                if (state.bound[slot])
+                {
+                    (*state.functions[slot])(message);
+                    ++executed;
+                }
+            }
+            passed.clear();
+            if (state.passed.capacity() < passed.capacity())
+            {
+                passed.swap(state.passed);
+            }
+            return executed;
+        }
+
+    private:
+
+        RoutedEvent(const RoutedEvent&) = delete;
+
+        RoutedEvent& operator=(const RoutedEvent&) = delete;
+
+        /*
+            Everything bound to the RoutedEvent, shared with the Binds so
+            that they can outlive it. Functions are kept by slot, and slots
+            are reused once they are unbound.
+        */
+        struct State
+        {
+            State():
+                live(0),
+                next_order(0),
+                generation(0),
+                firing(0)
+            {
+            }
+
+            std::size_t bind(const Filter& filter, const Function& function)
+            {
+                std::size_t slot;
+                if (this->free.empty())
+                {
+                    slot = this->bound.size();
+                    this->functions.emplace_back();
+                    this->filters.emplace_back();
+                    this->bound.push_back(false);
+                    this->order.push_back(0);
+                    this->stamps.push_back(0);
+                    this->passes.push_back(0);
+                }
+                else
+                {
+                    slot = this->free.back();
+                    this->free.pop_back();
+                }
+                this->functions[slot].reset(new Function(function));
+                this->filters[slot] = filter;
+                this->bound[slot] = true;
+                this->order[slot] = this->next_order++;
+                // a stamp from an earlier firing must not count
+                this->stamps[slot] = this->generation;
+                for (auto& condition: filter.conditions)
+                {
+                    condition->add(slot);
+                }
+                if (filter.conditions.empty())
+                {
+                    this->unfiltered.push_back(slot);
+                }
+                ++this->live;
+                return slot;
+            }
+
+            void unbind(std::size_t slot)
+            {
+                assert(this->bound[slot]);
+                auto& filter = this->filters[slot];
+                for (auto& condition: filter.conditions)
+                {
+                    condition->remove(slot);
+                }
+                if (filter.conditions.empty())
+                {
+                    this->unfiltered.erase(std::find(
+                        this->unfiltered.begin(),
+                        this->unfiltered.end(),
+                        slot
+                    ));
+                }
+                this->bound[slot] = false;
+                --this->live;
+                // the function may be executing, it is released once no
+                // firing is in progress
+                if (this->firing)
+                {
+                    this->released.push_back(slot);
+                }
+                else
+                {
+                    this->release(slot);
+                }
+            }
+
+            void release(std::size_t slot)
+            {
+                this->functions[slot].reset();
+                this->filters[slot] = Filter();
+                this->free.push_back(slot);
+            }
+
+            // A test of the function in slot passed, executes the function
+            // once all of its tests have.
+            void pass(std::size_t slot)
+            {
+                if (this->stamps[slot] != this->generation)
+                {
+                    this->stamps[slot] = this->generation;
+                    this->passes[slot] = 0;
+                }
+                if (
+                    ++this->passes[slot] ==
+                    this->filters[slot].conditions.size()
+                )
+                {
+                    this->passed.push_back(slot);
+                }
+            }
+
+            std::vector<std::unique_ptr<FieldIndex>> fields;
+
+            // By slot, stable while a firing executes them.
+            std::vector<std::unique_ptr<Function>> functions;
+
+            std::vector<Filter> filters;
+
+            std::vector<bool> bound;
+
+            // The order the functions were bound in.
+            std::vector<std::uint64_t> order;
+
+            // The tests passed by each function in the firing stamped with
+            // generation.
+            std::vector<std::uint64_t> stamps;
+
+            std::vector<std::size_t> passes;
+
+            // Slots without tests, executed for every message.
+            std::vector<std::size_t> unfiltered;
+
+            std::vector<std::size_t> free;
+
+            // Slots unbound while firing.
+            std::vector<std::size_t> released;
+
+            // Scratch space for the slots that pass a firing.
+            std::vector<std::size_t> passed;
+
+            std::size_t live;
+
+            std::uint64_t next_order;
+
+            std::uint64_t generation;
+
+            std::size_t firing;
+
+            // Set when the RoutedEvent is destroyed while firing, the last
+            // firing lets go of it.
+            std::shared_ptr<State> self;
+        };
+
+        /*
+            Marks a State as firing for the lifetime of the Firing.
+        */
+        class Firing
+        {
+            public:
+
+                explicit Firing(State& state):
+                    state(state)
+                {
+                    ++this->state.firing;
+                }
+
+                ~Firing()
+                {
+                    if (--this->state.firing)
+                    {
+                        return;
+                    }
+                    if (this->state.self)
+                    {
+                        // destroys the State last
+                        auto self = std::move(this->state.self);
+                        return;
+                    }
+                    for (auto slot: this->state.released)
+                    {
+                        this->state.release(slot);
+                    }
+                    this->state.released.clear();
+                }
+
+            private:
+
+                State& state;
+        };
+
+        std::shared_ptr<State> state;
+};
+
+#endif
@@ -0,0 +1,859 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_SENDER_HPP
+#define EVENT_SENDER_HPP
+
+// standard library
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+// event
+#include "event.hpp"
+
+/*
+    Senders and receivers in the style of P2300 (std::execution), so Events
+    can take part in asynchronous code without lambdas and Binds to manage.
+
+    A receiver is any object with the member functions:
+
+        void set_value(Values...);
+        void set_error(std::exception_ptr);
+        void set_stopped();
+
+    A sender is connected to a receiver, giving an operation. Once started
+    the operation completes the receiver exactly once. Senders that are
+    combined with when_all name the values they complete with as a Values
+    typedef of std::tuple.
+*/
+
+/*
+    The operation of waiting for the next firing of an Event. It holds the
+    receiver and is linked directly into the Event while waiting, so waiting
+    allocates nothing. The receiver's set_value is called with the arguments
+    of the firing, set_error if set_value throws, and set_stopped if the
+    Event is destroyed first. Destroying the operation before then cancels
+    it without completing the receiver.
+
+    Operations may be moved, even while waiting.
+*/
+template <typename Receiver, typename... Args>
+class EventOperation: event_detail::EventWaiter<Args...>
+{
+    public:
+
+        /*
+            Constructor
+        =====================================================================*/
+        EventOperation(Event<Args...>& event, Receiver receiver):
+            event(&event),
+            receiver(std::move(receiver))
+        {
+        }
+
+        /*
+            Move Constructor
+        =====================================================================*/
+        EventOperation(EventOperation&& other):
+            event(other.event),
+            receiver(std::move(other.receiver))
+        {
+            this->replace(other);
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~EventOperation()
+        {
+            this->unlink();
+        }
+
+        /*
+            start
+
+            Starts waiting for the next firing.
+        =====================================================================*/
+        void start()
+        {
+            assert(!this->is_waiting());
+            this->event->wait(*this);
+        }
+
+        /*
+            is_waiting
+
+            Returns true if the operation has started and not yet completed.
+        =====================================================================*/
+        bool is_waiting() const
+        {
+            return event_detail::EventWaiter<Args...>::is_waiting();
+        }
+
+    private:
+
+        EventOperation(const EventOperation&) = delete;
+
+        EventOperation& operator=(const EventOperation&) = delete;
+
+        void complete(Args&... args)
+        {
+            try
+            {
+                this->receiver.set_value(args...);
+            }
+            catch (...)
+            {
+                this->receiver.set_error(std::current_exception());
+            }
+        }
+
+        void stop()
+        {
+            this->receiver.set_stopped();
+        }
+
+        Event<Args...>* event;
+
+        Receiver receiver;
+};
+
+/*
+    A sender that completes with the arguments of the next firing of an
+    Event, returned by Event::as_sender.
+*/
+template <typename... Args>
+class EventSender
+{
+    public:
+
+        typedef std::tuple<typename std::decay<Args>::type...> Values;
+
+        /*
+            Constructor
+        =====================================================================*/
+        explicit EventSender(Event<Args...>& event):
+            event(&event)
+        {
+        }
+
+        /*
+            connect
+
+            Returns the operation of receiver waiting for the next firing,
+            which starts once its start is called.
+        =====================================================================*/
+        template <typename Receiver>
+        EventOperation<typename std::decay<Receiver>::type, Args...> connect(
+            Receiver&& receiver
+        ) const
+        {
+            return EventOperation<typename std::decay<Receiver>::type, Args...>(
+                *this->event,
+                std::forward<Receiver>(receiver)
+            );
+        }
+
+    private:
+
+        Event<Args...>* event;
+};
+
+namespace event_detail
+{
+    /*
+        The receiver connected to the sender adapted by then, it calls the
+        function with the values and completes the next receiver with the
+        result.
+    */
+    template <typename Function, typename Receiver>
+    class ThenReceiver
+    {
+        public:
+
+            ThenReceiver(Function function, Receiver receiver):
+                function(std::move(function)),
+                receiver(std::move(receiver))
+            {
+            }
+
+            template <typename... Values>
+            void set_value(Values&&... values)
+            {
+                typedef decltype(
+                    this->function(std::forward<Values>(values)...)
+                ) Result;
+                this->invoke(
+                    std::is_void<Result>(),
+                    std::forward<Values>(values)...
+                );
+            }
+
+            void set_error(std::exception_ptr error)
+            {
+                this->receiver.set_error(std::move(error));
+            }
+
+            void set_stopped()
+            {
+                this->receiver.set_stopped();
+            }
+
+        private:
+
+            template <typename... Values>
+            void invoke(std::true_type, Values&&... values)
+            {
+                this->function(std::forward<Values>(values)...);
+                this->receiver.set_value();
+            }
+
+            template <typename... Values>
+            void invoke(std::false_type, Values&&... values)
+            {
+                this->receiver.set_value(
+                    this->function(std::forward<Values>(values)...)
+                );
+            }
+
+            Function function;
+
+            Receiver receiver;
+    };
+
+    template <typename Sender, typename Function>
+    class ThenSender
+    {
+        public:
+
+            ThenSender(Sender sender, Function function):
+                sender(std::move(sender)),
+                function(std::move(function))
+            {
+            }
+
+            template <typename Receiver>
+            auto connect(Receiver&& receiver) const -> decltype(
+                std::declval<const Sender&>().connect(
+                    ThenReceiver<
+                        Function,
+                        typename std::decay<Receiver>::type
+                    >(
+                        std::declval<Function>(),
+                        std::declval<typename std::decay<Receiver>::type>()
+                    )
+                )
+            )
+            {
+                return this->sender.connect(
+                    ThenReceiver<
+                        Function,
+                        typename std::decay<Receiver>::type
+                    >(this->function, std::forward<Receiver>(receiver))
+                );
+            }
+
+        private:
+
+            Sender sender;
+
+            Function function;
+    };
+}
+
+/*
+    then
+
+    Adapts sender so that its values are passed to function, and the sender
+    completes with the result instead. If function throws the receiver's
+    set_error is called.
+
+        auto operation = then(
+            my_event.as_sender(),
+            [](int value){ return value * 2; }
+        ).connect(receiver);
+        operation.start();
+*/
+template <typename Sender, typename Function>
+event_detail::ThenSender<Sender, typename std::decay<Function>::type> then(
+    Sender sender,
+    Function&& function
+)
+{
+    return event_detail::ThenSender<
+        Sender,
+        typename std::decay<Function>::type
+    >(std::move(sender), std::forward<Function>(function));
+}
+
+namespace event_detail
+{
+    /*
+        SenderValues
+
+        The std::tuple of the values a sender completes with, as Type. Has
+        no Type for anything that is not a sender.
+    */
+    template <typename Sender, typename Enable = void>
+    struct SenderValues
+    {
+    };
+
+    template <typename Sender>
+    struct SenderValues<
+        Sender,
+        typename std::conditional<
+            true,
+            void,
+            typename Sender::Values
+        >::type
+    >
+    {
+        typedef typename Sender::Values Type;
+    };
+
+    template <typename T, typename Enable = void>
+    struct IsSender: std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsSender<
+        T,
+        typename std::conditional<
+            true,
+            void,
+            typename SenderValues<T>::Type
+        >::type
+    >: std::true_type
+    {
+    };
+
+    template <typename Function, typename Values>
+    struct ThenValues;
+
+    template <typename Function, typename... Values>
+    struct ThenValues<Function, std::tuple<Values...>>
+    {
+        typedef decltype(
+            std::declval<Function&>()(std::declval<Values&>()...)
+        ) Result;
+
+        typedef typename std::conditional<
+            std::is_void<Result>::value,
+            std::tuple<>,
+            std::tuple<typename std::decay<Result>::type>
+        >::type Type;
+    };
+
+    template <typename Sender, typename Function>
+    struct SenderValues<ThenSender<Sender, Function>, void>:
+        ThenValues<Function, typename SenderValues<Sender>::Type>
+    {
+    };
+
+    /*
+        The receiver connected to the sender adapted by schedule_on, it posts
+        the completion to the scheduler. The receiver is moved into the
+        posted work, so the operation may be destroyed once it completes
+        without waiting for the scheduler.
+    */
+    template <typename Scheduler, typename Receiver>
+    class ScheduleReceiver
+    {
+        public:
+
+            ScheduleReceiver(Scheduler& scheduler, Receiver receiver):
+                scheduler(&scheduler),
+                receiver(std::move(receiver))
+            {
+            }
+
+            template <typename... Values>
+            void set_value(Values&&... values)
+            {
+                typedef std::tuple<typename std::decay<Values>::type...> Tuple;
+                auto work = std::make_shared<std::pair<Receiver, Tuple>>(
+                    std::move(this->receiver),
+                    Tuple(std::forward<Values>(values)...)
+                );
+                this->scheduler->post([work]{
+                    try
+                    {
+                        ScheduleReceiver::apply(
+                            work->first,
+                            work->second,
+                            typename MakeIndexSequence<
+                                std::tuple_size<Tuple>::value
+                            >::Type()
+                        );
+                    }
+                    catch (...)
+                    {
+                        work->first.set_error(std::current_exception());
+                    }
+                });
+            }
+
+            void set_error(std::exception_ptr error)
+            {
+                auto work = std::make_shared<std::pair<
+                    Receiver,
+                    std::exception_ptr
+                >>(std::move(this->receiver), std::move(error));
+                this->scheduler->post([work]{
+                    work->first.set_error(std::move(work->second));
+                });
+            }
+
+            void set_stopped()
+            {
+                auto receiver = std::make_shared<Receiver>(
+                    std::move(this->receiver)
+                );
+                this->scheduler->post([receiver]{
+                    receiver->set_stopped();
+                });
+            }
+
+        private:
+
+            template <typename Tuple, std::size_t... Indices>
+            static void apply(
+                Receiver& receiver,
+                Tuple& values,
+                IndexSequence<Indices...>
+            )
+            {
+                receiver.set_value(std::move(std::get<Indices>(values))...);
+            }
+
+            Scheduler* scheduler;
+
+            Receiver receiver;
+    };
+
+    template <typename Scheduler, typename Sender>
+    class ScheduleSender
+    {
+        public:
+
+            ScheduleSender(Scheduler& scheduler, Sender sender):
+                scheduler(&scheduler),
+                sender(std::move(sender))
+            {
+            }
+
+            template <typename Receiver>
+            auto connect(Receiver&& receiver) const -> decltype(
+                std::declval<const Sender&>().connect(
+                    ScheduleReceiver<
+                        Scheduler,
+                        typename std::decay<Receiver>::type
+                    >(
+                        std::declval<Scheduler&>(),
+                        std::declval<typename std::decay<Receiver>::type>()
+                    )
+                )
+            )
+            {
+                return this->sender.connect(
+                    ScheduleReceiver<
+                        Scheduler,
+                        typename std::decay<Receiver>::type
+                    >(*this->scheduler, std::forward<Receiver>(receiver))
+                );
+            }
+
+        private:
+
+            Scheduler* scheduler;
+
+            Sender sender;
+    };
+
+    template <typename Scheduler, typename Sender>
+    struct SenderValues<ScheduleSender<Scheduler, Sender>, void>:
+        SenderValues<Sender>
+    {
+    };
+
+    /*
+        Space for the values of one sender combined by when_all, which are
+        only constructed once it completes.
+    */
+    template <typename Tuple>
+    class WhenAllValues
+    {
+        public:
+
+            WhenAllValues():
+                constructed(false)
+            {
+            }
+
+            ~WhenAllValues()
+            {
+                if (this->constructed)
+                {
+                    this->get().~Tuple();
+                }
+            }
+
+            template <typename... Values>
+            void emplace(Values&&... values)
+            {
+                assert(!this->constructed);
+                new (&this->storage) Tuple(std::forward<Values>(values)...);
+                this->constructed = true;
+            }
+
+            Tuple& get()
+            {
+                assert(this->constructed);
+                return *reinterpret_cast<Tuple*>(&this->storage);
+            }
+
+        private:
+
+            WhenAllValues(const WhenAllValues&) = delete;
+
+            WhenAllValues& operator=(const WhenAllValues&) = delete;
+
+            typename std::aligned_storage<
+                sizeof(Tuple),
+                alignof(Tuple)
+            >::type storage;
+
+            bool constructed;
+    };
+
+    /*
+        The state shared by the senders combined by when_all. The last of
+        them to complete, on whichever thread, completes the receiver.
+    */
+    template <typename Receiver, typename... Tuples>
+    class WhenAllState
+    {
+        public:
+
+            explicit WhenAllState(Receiver receiver):
+                receiver(std::move(receiver)),
+                remaining(sizeof...(Tuples)),
+                failed(false),
+                stopped(false)
+            {
+            }
+
+            template <std::size_t Index, typename... Values>
+            void set_value(Values&&... values)
+            {
+                std::get<Index>(this->values).emplace(
+                    std::forward<Values>(values)...
+                );
+                this->arrive();
+            }
+
+            void set_error(std::exception_ptr error)
+            {
+                if (!this->failed.exchange(true))
+                {
+                    this->error = std::move(error);
+                }
+                this->arrive();
+            }
+
+            void set_stopped()
+            {
+                this->stopped = true;
+                this->arrive();
+            }
+
+        private:
+
+            WhenAllState(const WhenAllState&) = delete;
+
+            WhenAllState& operator=(const WhenAllState&) = delete;
+
+            void arrive()
+            {
+                if (--this->remaining)
+                {
+                    return;
+                }
+                if (this->failed)
+                {
+                    this->receiver.set_error(std::move(this->error));
+                }
+                else if (this->stopped)
+                {
+                    this->receiver.set_stopped();
+                }
+                else
+                {
+                    try
+                    {
+                        this->complete(
+                            typename MakeIndexSequence<
+                                sizeof...(Tuples)
+                            >::Type()
+                        );
+                    }
+                    catch (...)
+                    {
+                        this->receiver.set_error(std::current_exception());
+                    }
+                }
+            }
+
+            template <std::size_t... Indices>
+            void complete(IndexSequence<Indices...>)
+            {
+                auto values = std::tuple_cat(
+                    std::move(std::get<Indices>(this->values).get())...
+                );
+                this->apply(
+                    values,
+                    typename MakeIndexSequence<
+                        std::tuple_size<decltype(values)>::value
+                    >::Type()
+                );
+            }
+
+            template <typename Tuple, std::size_t... Indices>
+            void apply(Tuple& values, IndexSequence<Indices...>)
+            {
+                this->receiver.set_value(
+                    std::move(std::get<Indices>(values))...
+                );
+            }
+
+            Receiver receiver;
+
+            std::tuple<WhenAllValues<Tuples>...> values;
+
+            std::atomic<std::size_t> remaining;
+
+            std::atomic<bool> failed;
+
+            std::exception_ptr error;
+
+            std::atomic<bool> stopped;
+    };
+
+    template <typename State, std::size_t Index>
+    class WhenAllReceiver
+    {
+        public:
+
+            explicit WhenAllReceiver(const std::shared_ptr<State>& state):
+                state(state)
+            {
+            }
+
+            template <typename... Values>
+            void set_value(Values&&... values)
+            {
+                this->state->template set_value<Index>(
+                    std::forward<Values>(values)...
+                );
+            }
+
+            void set_error(std::exception_ptr error)
+            {
+                this->state->set_error(std::move(error));
+            }
+
+            void set_stopped()
+            {
+                this->state->set_stopped();
+            }
+
+        private:
+
+            std::shared_ptr<State> state;
+    };
+
+    template <typename Receiver, typename Indices, typename... Senders>
+    class WhenAllOperation;
+
+    template <typename Receiver, std::size_t... Indices, typename... Senders>
+    class WhenAllOperation<Receiver, IndexSequence<Indices...>, Senders...>
+    {
+        public:
+
+            typedef WhenAllState<
+                Receiver,
+                typename SenderValues<Senders>::Type...
+            > State;
+
+            WhenAllOperation(
+                const std::tuple<Senders...>& senders,
+                Receiver receiver
+            ):
+                WhenAllOperation(
+                    senders,
+                    std::make_shared<State>(std::move(receiver))
+                )
+            {
+            }
+
+            WhenAllOperation(WhenAllOperation&& other):
+                operations(std::move(other.operations))
+            {
+            }
+
+            void start()
+            {
+                int started[] = {
+                    (std::get<Indices>(this->operations).start(), 0)...
+                };
+                (void)started;
+            }
+
+        private:
+
+            WhenAllOperation(const WhenAllOperation&) = delete;
+
+            WhenAllOperation& operator=(const WhenAllOperation&) = delete;
+
+            WhenAllOperation(
+                const std::tuple<Senders...>& senders,
+                const std::shared_ptr<State>& state
+            ):
+                operations(std::get<Indices>(senders).connect(
+                    WhenAllReceiver<State, Indices>(state)
+                )...)
+            {
+            }
+
+            std::tuple<decltype(
+                std::declval<const Senders&>().connect(
+                    std::declval<WhenAllReceiver<State, Indices>>()
+                )
+            )...> operations;
+    };
+
+    template <typename... Senders>
+    class WhenAllSender
+    {
+        public:
+
+            typedef decltype(std::tuple_cat(
+                std::declval<typename SenderValues<Senders>::Type>()...
+            )) Values;
+
+            explicit WhenAllSender(Senders... senders):
+                senders(std::move(senders)...)
+            {
+            }
+
+            template <typename Receiver>
+            WhenAllOperation<
+                typename std::decay<Receiver>::type,
+                typename MakeIndexSequence<sizeof...(Senders)>::Type,
+                Senders...
+            > connect(Receiver&& receiver) const
+            {
+                return WhenAllOperation<
+                    typename std::decay<Receiver>::type,
+                    typename MakeIndexSequence<sizeof...(Senders)>::Type,
+                    Senders...
+                >(this->senders, std::forward<Receiver>(receiver));
+            }
+
+        private:
+
+            std::tuple<Senders...> senders;
+    };
+}
+
+/*
+    schedule_on
+
+    Adapts sender so that it completes its receiver on scheduler instead of
+    on the thread that completed it, for example so an Event fired on a
+    realtime thread is handled on a pool. scheduler is any object with a
+    post(std::function<void()>) member, such as an EventThreadPool, and must
+    outlive the operation. The values are copied into the posted work.
+
+        auto operation = schedule_on(
+            pool,
+            my_event.as_sender()
+        ).connect(receiver);
+        operation.start();
+*/
+template <typename Scheduler, typename Sender>
+event_detail::ScheduleSender<Scheduler, Sender> schedule_on(
+    Scheduler& scheduler,
+    Sender sender
+)
+{
+    return event_detail::ScheduleSender<Scheduler, Sender>(
+        scheduler,
+        std::move(sender)
+    );
+}
+
+/*
+    when_all
+
+    Combines senders into one that completes once every one of them has,
+    with all of their values in order. If any of them fails the receiver's
+    set_error is called with the first error, otherwise if any of them is
+    stopped its set_stopped is called. when_all does not cancel the other
+    senders early, it always waits for every one of them to complete. The
+    state the senders share is allocated once, when connecting. This
+    overload only takes senders, when_all with a function and Events is
+    declared in event.hpp.
+
+        auto operation = when_all(
+            loaded.as_sender(),
+            configured.as_sender()
+        ).connect(receiver);
+        operation.start();
+*/
+template <typename... Senders>
+typename std::enable_if<
+    event_detail::And<
+        event_detail::IsSender<typename std::decay<Senders>::type>::value...
+    >::value,
+    event_detail::WhenAllSender<typename std::decay<Senders>::type...>
+>::type when_all(Senders&&... senders)
+{
+    static_assert(sizeof...(Senders) > 0, "when_all needs a sender");
+    return event_detail::WhenAllSender<
+        typename std::decay<Senders>::type...
+    >(std::forward<Senders>(senders)...);
+}
+
+#endif
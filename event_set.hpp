@@ -0,0 +1,495 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_SET_HPP
+#define EVENT_SET_HPP
+
+// standard library
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+    One list of functions per enumerator of Enum, all sharing the signature
+    Signature (void(Args...)). By default the enumeration must end with an
+    enumerator named count, otherwise the number of enumerators is given as
+    Count:
+
+        enum class Door { opened, closed, locked, count };
+        EventSet<Door, void(const Actor&)> events;
+
+    This behaves like an Event per enumerator, but the functions of every
+    enumerator are kept in one array, grouped by enumerator. Firing an
+    enumerator indexes its group directly, and a function can be bound to
+    several enumerators at once.
+*/
+template <
+    typename Enum,
+    typename Signature,
+    std::size_t Count = static_cast<std::size_t>(Enum::count)
+>
+class EventSet;
+
+template <typename Enum, typename... Args, std::size_t Count>
+class EventSet<Enum, void(Args...), Count>
+{
+    public:
+
+        typedef std::function<void(Args...)> Function;
+
+        // A set of enumerators.
+        typedef std::bitset<Count> Keys;
+
+    private:
+
+        struct Entry
+        {
+            Entry(const Function& function, std::uint64_t id):
+                function(function),
+                id(id),
+                removed(false)
+            {
+            }
+
+            Function function;
+
+            std::uint64_t id;
+
+            bool removed;
+        };
+
+        /*
+            The functions of every enumerator, shared with the Binds so that
+            they can outlive the EventSet.
+        */
+        struct State
+        {
+            State():
+                next_id(0),
+                firing(0),
+                dirty(false)
+            {
+                this->offsets.fill(0);
+            }
+
+            void bind(
+                std::size_t key,
+                const Function& function,
+                std::uint64_t id
+            )
+            {
+                if (this->firing)
+                {
+                    // the array being fired is never reallocated
+                    this->pending.emplace_back(key, Entry(function, id));
+                    return;
+                }
+                this->entries.emplace(
+                    this->entries.begin() + this->offsets[key + 1],
+                    function,
+                    id
+                );
+                for (auto i = key + 1; i <= Count; ++i)
+                {
+                    ++this->offsets[i];
+                }
+            }
+
+            void unbind(std::size_t key, std::uint64_t id)
+            {
+                auto begin = this->entries.begin() + this->offsets[key];
+                auto end = this->entries.begin() + this->offsets[key + 1];
+                auto found = std::find_if(begin, end, [id](const Entry& entry){
+                    return entry.id == id;
+                });
+                if (found == end)
+                {
+                    auto pending = std::find_if(
+                        this->pending.begin(),
+                        this->pending.end(),
+                        [key, id](const std::pair<std::size_t, Entry>& entry){
+                            return entry.first == key && entry.second.id == id;
+                        }
+                    );
+                    if (pending != this->pending.end())
+                    {
+                        this->pending.erase(pending);
+                    }
+                }
+                else if (this->firing)
+                {
+                    found->removed = true;
+                    this->dirty = true;
+                }
+                else
+                {
+                    this->entries.erase(found);
+                    for (auto i = key + 1; i <= Count; ++i)
+                    {
+                        --this->offsets[i];
+                    }
+                }
+            }
+
+            // Called once the outermost firing has finished, rebuilds the
+            // array without the removed functions and with the pending ones.
+            void settle()
+            {
+                if (!this->dirty && this->pending.empty())
+                {
+                    return;
+                }
+                std::vector<Entry> entries;
+                entries.reserve(this->entries.size() + this->pending.size());
+                std::array<std::size_t, Count + 1> offsets;
+                offsets[0] = 0;
+                for (std::size_t key = 0; key < Count; ++key)
+                {
+                    for (
+                        auto i = this->offsets[key];
+                        i < this->offsets[key + 1];
+                        ++i
+                    )
+                    {
+                        if (!this->entries[i].removed)
+                        {
+                            entries.push_back(std::move(this->entries[i]));
+                        }
+                    }
+                    for (auto& pending: this->pending)
+                    {
+                        if (pending.first == key)
+                        {
+                            entries.push_back(std::move(pending.second));
+                        }
+                    }
+                    offsets[key + 1] = entries.size();
+                }
+                this->entries.swap(entries);
+                this->offsets = offsets;
+                this->pending.clear();
+                this->dirty = false;
+            }
+
+            // The functions grouped by enumerator, those of enumerator key
+            // are in [offsets[key], offsets[key + 1]).
+            std::vector<Entry> entries;
+
+            std::array<std::size_t, Count + 1> offsets;
+
+            // Functions bound while firing, by enumerator.
+            std::vector<std::pair<std::size_t, Entry>> pending;
+
+            std::uint64_t next_id;
+
+            std::size_t firing;
+
+            bool dirty;
+
+            // Set when the EventSet is destroyed while firing, the last
+            // firing lets go of it.
+            std::shared_ptr<State> self;
+        };
+
+        /*
+            Marks a State as firing for the lifetime of the Firing.
+        */
+        class Firing
+        {
+            public:
+
+                explicit Firing(State& state):
+                    state(state)
+                {
+                    ++this->state.firing;
+                }
+
+                ~Firing()
+                {
+                    if (--this->state.firing)
+                    {
+                        return;
+                    }
+                    if (this->state.self)
+                    {
+                        // destroys the State last
+                        auto self = std::move(this->state.self);
+                        return;
+                    }
+                    this->state.settle();
+                }
+
+            private:
+
+                State& state;
+        };
+
+    public:
+
+        /*
+            An object that has ownership of a bind to an EventSet, the
+            function is unbound from all of its enumerators when the Bind is
+            destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    this->unbind(this->keys);
+                }
+
+                /*
+                    unbind
+
+                    Unbinds the function from the enumerators in keys early,
+                    it stays bound to the rest.
+                =============================================================*/
+                void unbind(Keys keys)
+                {
+                    keys &= this->keys;
+                    this->keys &= ~keys;
+                    auto state = this->state.lock();
+                    if (!state)
+                    {
+                        return;
+                    }
+                    for (std::size_t key = 0; key < Count; ++key)
+                    {
+                        if (keys[key])
+                        {
+                            state->unbind(key, this->id);
+                        }
+                    }
+                }
+
+                /*
+                    unbind
+
+                    Unbinds the function from key early.
+                =============================================================*/
+                void unbind(Enum key)
+                {
+                    this->unbind(EventSet::keys({key}));
+                }
+
+                /*
+                    bound_keys
+
+                    The enumerators the function is still bound to.
+                =============================================================*/
+                const Keys& bound_keys() const
+                {
+                    return this->keys;
+                }
+
+            private:
+
+                friend class EventSet;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(
+                    const std::shared_ptr<State>& state,
+                    std::uint64_t id,
+                    Keys keys
+                ):
+                    state(state),
+                    id(id),
+                    keys(keys)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                std::uint64_t id;
+
+                Keys keys;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        EventSet():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~EventSet()
+        {
+            if (this->state->firing)
+            {
+                for (auto& entry: this->state->entries)
+                {
+                    entry.removed = true;
+                }
+                this->state->pending.clear();
+                this->state->self = std::move(this->state);
+            }
+        }
+
+        /*
+            keys
+
+            The set of the enumerators given.
+        =====================================================================*/
+        static Keys keys(std::initializer_list<Enum> enumerators)
+        {
+            Keys keys;
+            for (auto key: enumerators)
+            {
+                assert(static_cast<std::size_t>(key) < Count);
+                keys.set(static_cast<std::size_t>(key));
+            }
+            return keys;
+        }
+
+        /*
+            bind
+
+            Binds a function to key for the duration of the Bind returned.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(Enum key, const Function& function)
+        {
+            return this->bind(keys({key}), function);
+        }
+
+        /*
+            bind
+
+            Binds a function to every enumerator in keys at once, for the
+            duration of the Bind returned. The enumerators share the
+            function rather than each having a copy.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(Keys keys, const Function& function)
+        {
+            auto id = this->state->next_id++;
+            auto bound = function;
+            if (keys.count() > 1)
+            {
+                auto shared = std::make_shared<Function>(function);
+                bound = [shared](Args... args){
+                    (*shared)(args...);
+                };
+            }
+            for (std::size_t key = 0; key < Count; ++key)
+            {
+                if (keys[key])
+                {
+                    this->state->bind(key, bound, id);
+                }
+            }
+            return std::shared_ptr<Bind>(new Bind(this->state, id, keys));
+        }
+
+        /*
+            has_handlers
+
+            Returns true if at least one function is bound to key.
+        =====================================================================*/
+        bool has_handlers(Enum key) const
+        {
+            auto index = static_cast<std::size_t>(key);
+            assert(index < Count);
+            auto& state = *this->state;
+            for (
+                auto i = state.offsets[index];
+                i < state.offsets[index + 1];
+                ++i
+            )
+            {
+                if (!state.entries[i].removed)
+                {
+                    return true;
+                }
+            }
+            for (auto& pending: state.pending)
+            {
+                if (pending.first == index)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /*
+            fire
+
+            Executes the functions bound to key using the arguments provided.
+            Returns the number of functions executed.
+        =====================================================================*/
+        std::size_t fire(Enum key, Args... args)
+        {
+            auto index = static_cast<std::size_t>(key);
+            assert(index < Count);
+            auto& state = *this->state;
+            auto begin = state.offsets[index];
+            auto end = state.offsets[index + 1];
+            if (begin == end)
+            {
+                return 0;
+            }
+            Firing firing(state);
+            std::size_t executed = 0;
+            for (auto i = begin; i < end; ++i)
+            {
+                auto& entry = state.entries[i];
+                if (!entry.removed)
+                {
+                    entry.function(args...);
+                    ++executed;
+                }
+            }
+            return executed;
+        }
+
+    private:
+
+        EventSet(const EventSet&) = delete;
+
+        EventSet& operator=(const EventSet&) = delete;
+
+        std::shared_ptr<State> state;
+};
+
+#endif
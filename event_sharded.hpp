@@ -0,0 +1,315 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_SHARDED_HPP
+#define EVENT_SHARDED_HPP
+
+// standard library
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace event_detail
+{
+    /*
+        shard_hint
+
+        A number that is stable for the calling thread and differs between
+        threads created one after another, used to spread threads across
+        shards.
+    */
+    inline std::size_t shard_hint()
+    {
+        static std::atomic<std::size_t> next(0);
+        static thread_local std::size_t hint = next++;
+        return hint;
+    }
+}
+
+/*
+    An Event for functions that are bound and unbound from many threads at
+    once. The bound functions are spread across a number of shards, each with
+    its own lock, and a thread always binds to the same shard, so threads only
+    contend with the few others that share their shard. Firing goes through
+    every shard.
+
+    Binding and unbinding only change the shard's own list. Firing takes an
+    immutable copy of each shard's list, which is made at most once per
+    change, so it only holds a shard's lock long enough to take the copy.
+    Functions may bind and unbind while the ShardedEvent is firing. A
+    function unbound while firing is not executed unless it has already
+    started.
+
+    Functions in the same shard execute in the order they were bound, there is
+    no order between shards.
+*/
+template <typename... Args>
+class ShardedEvent
+{
+    public:
+
+        typedef std::function<void(Args...)> Function;
+
+    private:
+
+        struct Handler
+        {
+            explicit Handler(const Function& function):
+                function(function),
+                bound(true)
+            {
+            }
+
+            Function function;
+
+            std::atomic<bool> bound;
+        };
+
+        typedef std::vector<std::shared_ptr<Handler>> Handlers;
+
+        // Aligned so that shards next to each other in memory are kept off
+        // each other's cache lines.
+        struct alignas(64) Shard
+        {
+            // Returns the functions bound to the shard, rebuilding the list
+            // handed out to firings if the shard changed since the last one.
+            std::shared_ptr<const Handlers> get()
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (!this->snapshot && !this->handlers.empty())
+                {
+                    this->snapshot = std::make_shared<const Handlers>(
+                        this->handlers
+                    );
+                }
+                return this->snapshot;
+            }
+
+            void bind(const std::shared_ptr<Handler>& handler)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->handlers.push_back(handler);
+                this->snapshot.reset();
+            }
+
+            void unbind(const std::shared_ptr<Handler>& handler)
+            {
+                handler->bound = false;
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->handlers.erase(std::find(
+                    this->handlers.begin(),
+                    this->handlers.end(),
+                    handler
+                ));
+                this->snapshot.reset();
+            }
+
+            std::mutex mutex;
+
+            Handlers handlers;
+
+            // The list handed out to firings, null once the shard has
+            // changed. Binding only invalidates it, so the cost of copying
+            // is paid by the next firing rather than by every bind.
+            std::shared_ptr<const Handlers> snapshot;
+        };
+
+        struct State
+        {
+            // new only respects the alignment of Shard from C++17, so the
+            // shards are placed in storage aligned by hand.
+            explicit State(std::size_t shard_count):
+                shard_count(std::max<std::size_t>(shard_count, 1)),
+                storage(new unsigned char[
+                    this->shard_count * sizeof(Shard) + alignof(Shard) - 1
+                ])
+            {
+                void* aligned = this->storage.get();
+                auto space = this->shard_count * sizeof(Shard) +
+                    alignof(Shard) - 1;
+                this->shards = static_cast<Shard*>(std::align(
+                    alignof(Shard),
+                    this->shard_count * sizeof(Shard),
+                    aligned,
+                    space
+                ));
+                assert(this->shards);
+                for (std::size_t i = 0; i < this->shard_count; ++i)
+                {
+                    new (&this->shards[i]) Shard();
+                }
+            }
+
+            ~State()
+            {
+                for (std::size_t i = 0; i < this->shard_count; ++i)
+                {
+                    this->shards[i].~Shard();
+                }
+            }
+
+            State(const State&) = delete;
+
+            State& operator=(const State&) = delete;
+
+            std::size_t shard_count;
+
+            std::unique_ptr<unsigned char[]> storage;
+
+            Shard* shards;
+        };
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a ShardedEvent, the
+            function is unbound when the Bind is destroyed. May be destroyed
+            on any thread.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    if (auto state = this->state.lock())
+                    {
+                        state->shards[this->shard].unbind(this->handler);
+                    }
+                }
+
+            private:
+
+                friend class ShardedEvent<Args...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(
+                    const std::shared_ptr<State>& state,
+                    std::size_t shard,
+                    const std::shared_ptr<Handler>& handler
+                ):
+                    state(state),
+                    shard(shard),
+                    handler(handler)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                std::size_t shard;
+
+                std::shared_ptr<Handler> handler;
+        };
+
+        /*
+            Constructor
+
+            Creates the ShardedEvent with shard_count shards, by default one
+            per hardware thread.
+        =====================================================================*/
+        explicit ShardedEvent(
+            std::size_t shard_count = std::thread::hardware_concurrency()
+        ):
+            state(std::make_shared<State>(shard_count))
+        {
+        }
+
+        /*
+            bind
+
+            Binds a function to the calling thread's shard for the duration of
+            the Bind returned.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind(const Function& function)
+        {
+            auto shard = event_detail::shard_hint() % this->state->shard_count;
+            auto handler = std::make_shared<Handler>(function);
+            this->state->shards[shard].bind(handler);
+            return std::shared_ptr<Bind>(
+                new Bind(this->state, shard, handler)
+            );
+        }
+
+        /*
+            shard_count
+
+            The number of shards the functions are spread across.
+        =====================================================================*/
+        std::size_t shard_count() const
+        {
+            return this->state->shard_count;
+        }
+
+        /*
+            fire
+
+            Executes all bound functions using the arguments provided, one
+            shard after another. Returns the number of functions executed.
+        =====================================================================*/
+        std::size_t fire(Args... args)
+        {
+            std::size_t executed = 0;
+            for (std::size_t i = 0; i < this->state->shard_count; ++i)
+            {
+                auto handlers = this->state->shards[i].get();
+                if (!handlers)
+                {
+                    continue;
+                }
+                for (auto& handler: *handlers)
+                {
+                    if (handler->bound)
+                    {
+                        handler->function(args...);
+                        ++executed;
+                    }
+                }
+            }
+            return executed;
+        }
+
+    private:
+
+        ShardedEvent(const ShardedEvent&) = delete;
+
+        ShardedEvent& operator=(const ShardedEvent&) = delete;
+
+        std::shared_ptr<State> state;
+};
+
+#endif
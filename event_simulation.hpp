@@ -0,0 +1,271 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_SIMULATION_HPP
+#define EVENT_SIMULATION_HPP
+
+// standard library
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+// event
+#include "event_executor.hpp"
+
+/*
+    Throughput of a simulation, as measured by SimulationExecutor.
+*/
+struct SimulationReport
+{
+    // The amount of virtual time that has passed.
+    std::chrono::nanoseconds simulated;
+
+    // The number of pieces of work run.
+    std::size_t work;
+
+    // The number of firings performed through the executor.
+    std::size_t fires;
+
+    // The number of functions executed by those firings.
+    std::size_t handler_invocations;
+
+    double fires_per_second() const
+    {
+        return this->per_second(this->fires);
+    }
+
+    double handler_invocations_per_second() const
+    {
+        return this->per_second(this->handler_invocations);
+    }
+
+    private:
+
+        double per_second(std::size_t count) const
+        {
+            if (this->simulated.count() <= 0)
+            {
+                return 0;
+            }
+            return count / std::chrono::duration<double>(
+                this->simulated
+            ).count();
+        }
+};
+
+/*
+    An EventExecutor that runs everything on the calling thread against a
+    virtual clock. Time only advances when the executor runs out of work due
+    at the current time, so hours of simulated traffic take as long as the
+    work itself.
+
+    Runs are deterministic for a given seed. Work on different lanes that is
+    due at the same time runs in an order chosen by the seed, so rare
+    interleavings of cross-thread deliveries can be found by trying seeds and
+    then replayed by reusing the seed. Work posted to a single lane always
+    keeps its order.
+*/
+class SimulationExecutor: public EventExecutor
+{
+    public:
+
+        /*
+            Constructor
+        =====================================================================*/
+        explicit SimulationExecutor(std::uint64_t seed = 0):
+            random(seed),
+            current(),
+            work_run(0),
+            fires(0),
+            handler_invocations(0)
+        {
+        }
+
+        Clock::time_point now() const
+        {
+            return this->current;
+        }
+
+        void post_at(Clock::time_point when, Work work, std::size_t lane = 0)
+        {
+            if (lane >= this->lanes.size())
+            {
+                this->lanes.resize(lane + 1);
+            }
+            // equal keys are kept in insertion order, which keeps the lane in
+            // posting order
+            this->lanes[lane].emplace(
+                std::max(when, this->current),
+                std::move(work)
+            );
+        }
+
+        /*
+            run_one
+
+            Advances the clock to the next due piece of work and runs it.
+            Returns false if there was no work.
+        =====================================================================*/
+        bool run_one()
+        {
+            return this->run_one(Clock::time_point::max());
+        }
+
+        /*
+            run
+
+            Runs work until there is none left. Returns the number of pieces
+            of work run.
+        =====================================================================*/
+        std::size_t run()
+        {
+            std::size_t count = 0;
+            while (this->run_one())
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        /*
+            run_until
+
+            Runs all work due up to and including when, then advances the
+            clock to when. Returns the number of pieces of work run.
+        =====================================================================*/
+        std::size_t run_until(Clock::time_point when)
+        {
+            std::size_t count = 0;
+            while (this->run_one(when))
+            {
+                ++count;
+            }
+            this->current = std::max(this->current, when);
+            return count;
+        }
+
+        /*
+            run_for
+
+            Runs all work due within duration of the current time.
+        =====================================================================*/
+        std::size_t run_for(Clock::duration duration)
+        {
+            return this->run_until(this->current + duration);
+        }
+
+        /*
+            report
+
+            Throughput since the executor was created.
+        =====================================================================*/
+        SimulationReport report() const
+        {
+            SimulationReport report;
+            report.simulated = std::chrono::duration_cast<
+                std::chrono::nanoseconds
+            >(this->current.time_since_epoch());
+            report.work = this->work_run;
+            report.fires = this->fires;
+            report.handler_invocations = this->handler_invocations;
+            return report;
+        }
+
+    protected:
+
+        void fired(std::size_t handlers)
+        {
+            ++this->fires;
+            this->handler_invocations += handlers;
+        }
+
+    private:
+
+        typedef std::multimap<Clock::time_point, Work> Lane;
+
+        bool run_one(Clock::time_point limit)
+        {
+            // Find the lanes whose next work is due soonest and pick one of
+            // them with the seed.
+            auto soonest = limit;
+            this->candidates.clear();
+            for (std::size_t i = 0; i < this->lanes.size(); ++i)
+            {
+                auto& lane = this->lanes[i];
+                if (lane.empty() || lane.begin()->first > soonest)
+                {
+                    continue;
+                }
+                if (lane.begin()->first < soonest)
+                {
+                    soonest = lane.begin()->first;
+                    this->candidates.clear();
+                }
+                this->candidates.push_back(i);
+            }
+            if (this->candidates.empty())
+            {
+                return false;
+            }
+            auto chosen = this->candidates[0];
+            if (this->candidates.size() > 1)
+            {
+                std::uniform_int_distribution<std::size_t> distribution(
+                    0,
+                    this->candidates.size() - 1
+                );
+                chosen = this->candidates[distribution(this->random)];
+            }
+
+            auto& lane = this->lanes[chosen];
+            auto work = std::move(lane.begin()->second);
+            lane.erase(lane.begin());
+            this->current = soonest;
+            ++this->work_run;
+            work();
+            return true;
+        }
+
+        std::mt19937_64 random;
+
+        Clock::time_point current;
+
+        std::vector<Lane> lanes;
+
+        std::vector<std::size_t> candidates;
+
+        std::size_t work_run;
+
+        std::size_t fires;
+
+        std::size_t handler_invocations;
+};
+
+#endif
@@ -0,0 +1,254 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_TABLE_HPP
+#define EVENT_TABLE_HPP
+
+// standard library
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+// event
+#include "event.hpp"
+
+/*
+    Declares the signature of one enumerator of an EventTable. Specialize it
+    for every enumerator, usually by deriving from EventTableSignature:
+
+        enum class EntityEvent { moved, died };
+
+        template <>
+        struct EventTableEntry<EntityEvent, EntityEvent::moved>:
+            EventTableSignature<int, int>
+        {
+        };
+*/
+template <typename Enum, Enum Key>
+struct EventTableEntry;
+
+template <typename... Args>
+struct EventTableSignature
+{
+    typedef Event<Args...> Type;
+};
+
+/*
+    A set of Events keyed by an enumeration, where only the Events that are
+    actually used take up memory. An EventTable is the size of a pointer until
+    something is bound, after which it holds a small array of the Events that
+    have been bound to, sorted by enumerator.
+
+    Useful for objects with many Events that are rarely bound, the cost of a
+    lookup is only paid when binding and firing.
+*/
+template <typename Enum>
+class EventTable
+{
+    public:
+
+        /*
+            Constructor
+        =====================================================================*/
+        EventTable()
+        {
+        }
+
+        /*
+            get
+
+            The Event for Key, created if it does not exist yet. The reference
+            stays valid until the EventTable is destroyed or compacted.
+        =====================================================================*/
+        template <Enum Key>
+        typename EventTableEntry<Enum, Key>::Type& get()
+        {
+            typedef typename EventTableEntry<Enum, Key>::Type Type;
+            if (!this->entries)
+            {
+                this->entries.reset(new Entries());
+            }
+            auto entry = this->lower_bound(Key);
+            if (entry == this->entries->end() || entry->first != Key)
+            {
+                entry = this->entries->emplace(
+                    entry,
+                    Key,
+                    std::unique_ptr<Slot>(new Holder<Type>())
+                );
+            }
+            return static_cast<Holder<Type>*>(entry->second.get())->event;
+        }
+
+        /*
+            find
+
+            The Event for Key, or null if it does not exist. Never allocates.
+        =====================================================================*/
+        template <Enum Key>
+        typename EventTableEntry<Enum, Key>::Type* find() const
+        {
+            typedef typename EventTableEntry<Enum, Key>::Type Type;
+            if (!this->entries)
+            {
+                return 0;
+            }
+            auto entry = this->lower_bound(Key);
+            if (entry == this->entries->end() || entry->first != Key)
+            {
+                return 0;
+            }
+            return &static_cast<Holder<Type>*>(entry->second.get())->event;
+        }
+
+        /*
+            bind
+
+            Binds a function to the Event for Key.
+        =====================================================================*/
+        template <Enum Key>
+        std::shared_ptr<typename EventTableEntry<Enum, Key>::Type::Bind> bind(
+            const typename EventTableEntry<Enum, Key>::Type::Function& function
+        )
+        {
+            return this->get<Key>().bind(function);
+        }
+
+        /*
+            has_handlers
+
+            Returns true if at least one function is bound to the Event for
+            Key.
+        =====================================================================*/
+        template <Enum Key>
+        bool has_handlers() const
+        {
+            auto event = this->find<Key>();
+            return event && event->has_handlers();
+        }
+
+        /*
+            fire
+
+            Fires the Event for Key if it exists. Returns the number of
+            functions executed.
+        =====================================================================*/
+        template <Enum Key, typename... Values>
+        std::size_t fire(Values&&... values)
+        {
+            auto event = this->find<Key>();
+            if (!event)
+            {
+                return 0;
+            }
+            return event->fire(std::forward<Values>(values)...);
+        }
+
+        /*
+            size
+
+            The number of Events that currently exist in the table.
+        =====================================================================*/
+        std::size_t size() const
+        {
+            return this->entries ? this->entries->size() : 0;
+        }
+
+        /*
+            compact
+
+            Destroys the Events that no longer have any functions bound,
+            releasing all memory if none are left. References returned by get
+            for the destroyed Events become invalid.
+        =====================================================================*/
+        void compact()
+        {
+            if (!this->entries)
+            {
+                return;
+            }
+            this->entries->erase(
+                std::remove_if(
+                    this->entries->begin(),
+                    this->entries->end(),
+                    [](const Entry& entry){
+                        return !entry.second->has_handlers();
+                    }
+                ),
+                this->entries->end()
+            );
+            if (this->entries->empty())
+            {
+                this->entries.reset();
+            }
+        }
+
+    private:
+
+        EventTable(const EventTable&) = delete;
+
+        EventTable& operator=(const EventTable&) = delete;
+
+        struct Slot
+        {
+            virtual ~Slot()
+            {
+            }
+
+            virtual bool has_handlers() const = 0;
+        };
+
+        template <typename Type>
+        struct Holder: Slot
+        {
+            bool has_handlers() const
+            {
+                return this->event.has_handlers();
+            }
+
+            Type event;
+        };
+
+        typedef std::pair<Enum, std::unique_ptr<Slot>> Entry;
+
+        typedef std::vector<Entry> Entries;
+
+        typename Entries::iterator lower_bound(Enum key) const
+        {
+            return std::lower_bound(
+                this->entries->begin(),
+                this->entries->end(),
+                key,
+                [](const Entry& entry, Enum key){
+                    return entry.first < key;
+                }
+            );
+        }
+
+        std::unique_ptr<Entries> entries;
+};
+
+#endif
@@ -0,0 +1,464 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_THREAD_LOCAL_HPP
+#define EVENT_THREAD_LOCAL_HPP
+
+// standard library
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+// event
+#include "event.hpp"
+
+/*
+    An Event whose functions belong to the thread that bound them. Each thread
+    keeps its own functions in a contiguous array that only it touches, so
+    fire_local executes the calling thread's functions without any locks or
+    atomics and never executes a function on the wrong thread.
+
+    fire_all broadcasts a firing to every thread with functions bound by
+    queueing it in each thread's mailbox. A thread executes the firings in its
+    mailbox when it calls deliver, for example once per iteration of its
+    loop.
+
+    A Bind must be destroyed on the thread that made it. A thread's functions
+    and its mailbox are freed once its last Bind is destroyed, after which
+    fire_all no longer mails it.
+*/
+template <typename... Args>
+class ThreadLocalEvent
+{
+    public:
+
+        typedef std::function<void(Args...)> Function;
+
+    private:
+
+        struct Handler
+        {
+            Handler(const Function& function, std::uint64_t id):
+                function(function),
+                id(id),
+                removed(false)
+            {
+            }
+
+            Function function;
+
+            std::uint64_t id;
+
+            bool removed;
+        };
+
+        typedef std::tuple<typename std::decay<Args>::type...> Mail;
+
+        /*
+            The functions one thread has bound to one ThreadLocalEvent.
+        */
+        struct Local
+        {
+            explicit Local(std::size_t event_id):
+                event_id(event_id),
+                binds(0),
+                next_id(0),
+                firing(0),
+                dirty(false)
+            {
+            }
+
+            std::uint64_t bind(const Function& function)
+            {
+                auto id = this->next_id++;
+                // Functions bound while firing wait in pending, so that the
+                // array being fired is never reallocated.
+                (this->firing ? this->pending : this->handlers).emplace_back(
+                    function,
+                    id
+                );
+                return id;
+            }
+
+            void unbind(std::uint64_t id)
+            {
+                auto matches = [id](const Handler& handler){
+                    return handler.id == id;
+                };
+                auto found = std::find_if(
+                    this->handlers.begin(),
+                    this->handlers.end(),
+                    matches
+                );
+                if (found == this->handlers.end())
+                {
+                    this->pending.erase(std::find_if(
+                        this->pending.begin(),
+                        this->pending.end(),
+                        matches
+                    ));
+                }
+                else if (this->firing)
+                {
+                    found->removed = true;
+                    this->dirty = true;
+                }
+                else
+                {
+                    this->handlers.erase(found);
+                }
+            }
+
+            std::size_t fire(Args&... args)
+            {
+                Firing firing(*this);
+                std::size_t executed = 0;
+                auto count = this->handlers.size();
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    auto& handler = this->handlers[i];
+                    if (!handler.removed)
+                    {
+                        handler.function(args...);
+                        ++executed;
+                    }
+                }
+                return executed;
+            }
+
+            template <std::size_t... Indices>
+            std::size_t fire(
+                Mail& mail,
+                event_detail::IndexSequence<Indices...>
+            )
+            {
+                return this->fire(std::get<Indices>(mail)...);
+            }
+
+            // Called once the outermost firing has finished.
+            void settle()
+            {
+                if (this->dirty)
+                {
+                    this->handlers.erase(
+                        std::remove_if(
+                            this->handlers.begin(),
+                            this->handlers.end(),
+                            [](const Handler& handler){
+                                return handler.removed;
+                            }
+                        ),
+                        this->handlers.end()
+                    );
+                    this->dirty = false;
+                }
+                for (auto& handler: this->pending)
+                {
+                    this->handlers.push_back(std::move(handler));
+                }
+                this->pending.clear();
+            }
+
+            /*
+                Marks a Local as firing for the lifetime of the Firing.
+            */
+            class Firing
+            {
+                public:
+
+                    explicit Firing(Local& local):
+                        local(local)
+                    {
+                        ++this->local.firing;
+                    }
+
+                    ~Firing()
+                    {
+                        if (--this->local.firing == 0)
+                        {
+                            this->local.settle();
+                            if (!this->local.binds)
+                            {
+                                // the last Bind was destroyed while firing,
+                                // this destroys the Local
+                                ThreadLocalEvent::release_local(this->local);
+                            }
+                        }
+                    }
+
+                private:
+
+                    Local& local;
+            };
+
+            std::vector<Handler> handlers;
+
+            std::vector<Handler> pending;
+
+            std::size_t event_id;
+
+            // The number of Binds, the Local is released when the last one
+            // is destroyed.
+            std::size_t binds;
+
+            std::uint64_t next_id;
+
+            std::size_t firing;
+
+            bool dirty;
+
+            // Guards the mailbox, the only part of a Local other threads
+            // touch.
+            std::mutex mutex;
+
+            std::vector<Mail> mailbox;
+        };
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a ThreadLocalEvent, the
+            function is unbound when the Bind is destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    // only the thread that made the bind may unbind it
+                    assert(
+                        ThreadLocalEvent::find_local(this->event_id) ==
+                        this->local.get()
+                    );
+                    this->local->unbind(this->id);
+                    if (--this->local->binds == 0 && !this->local->firing)
+                    {
+                        ThreadLocalEvent::release_local(*this->local);
+                    }
+                }
+
+            private:
+
+                friend class ThreadLocalEvent<Args...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(
+                    std::size_t event_id,
+                    const std::shared_ptr<Local>& local,
+                    std::uint64_t id
+                ):
+                    event_id(event_id),
+                    local(local),
+                    id(id)
+                {
+                }
+
+                std::size_t event_id;
+
+                std::shared_ptr<Local> local;
+
+                std::uint64_t id;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        ThreadLocalEvent():
+            id(next_event_id()++)
+        {
+        }
+
+        /*
+            bind_thread_local
+
+            Binds a function that only executes on the calling thread, for the
+            duration of the Bind returned.
+        =====================================================================*/
+        std::shared_ptr<Bind> bind_thread_local(const Function& function)
+        {
+            auto& local = thread_locals()[this->id];
+            if (!local)
+            {
+                local = std::make_shared<Local>(this->id);
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->locals.push_back(local);
+            }
+            auto id = local->bind(function);
+            ++local->binds;
+            return std::shared_ptr<Bind>(new Bind(this->id, local, id));
+        }
+
+        /*
+            fire_local
+
+            Executes the functions bound on the calling thread using the
+            arguments provided. Returns the number of functions executed.
+        =====================================================================*/
+        std::size_t fire_local(Args... args)
+        {
+            auto local = find_local(this->id);
+            if (!local)
+            {
+                return 0;
+            }
+            return local->fire(args...);
+        }
+
+        /*
+            fire_all
+
+            Queues a copy of the arguments in the mailbox of every thread that
+            has bound to the ThreadLocalEvent, to be fired by each when it
+            calls deliver. Returns the number of threads mailed.
+        =====================================================================*/
+        template <typename... Values>
+        std::size_t fire_all(Values&&... values)
+        {
+            std::size_t mailed = 0;
+            std::lock_guard<std::mutex> lock(this->mutex);
+            for (auto weak = this->locals.begin(); weak != this->locals.end();)
+            {
+                auto local = weak->lock();
+                if (!local)
+                {
+                    // the thread has exited
+                    weak = this->locals.erase(weak);
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> mailbox_lock(local->mutex);
+                    local->mailbox.emplace_back(values...);
+                }
+                ++mailed;
+                ++weak;
+            }
+            return mailed;
+        }
+
+        /*
+            deliver
+
+            Fires the calling thread's functions with every firing queued in
+            its mailbox by fire_all, in the order they were queued. Returns
+            the number of firings delivered.
+        =====================================================================*/
+        std::size_t deliver()
+        {
+            auto& locals = thread_locals();
+            auto found = locals.find(this->id);
+            if (found == locals.end())
+            {
+                return 0;
+            }
+            // the functions may destroy the last Bind
+            auto local = found->second;
+            std::vector<Mail> mailbox;
+            {
+                std::lock_guard<std::mutex> lock(local->mutex);
+                mailbox.swap(local->mailbox);
+            }
+            for (auto& mail: mailbox)
+            {
+                local->fire(
+                    mail,
+                    typename event_detail::MakeIndexSequence<
+                        sizeof...(Args)
+                    >::Type()
+                );
+            }
+            return mailbox.size();
+        }
+
+    private:
+
+        ThreadLocalEvent(const ThreadLocalEvent&) = delete;
+
+        ThreadLocalEvent& operator=(const ThreadLocalEvent&) = delete;
+
+        typedef std::unordered_map<std::size_t, std::shared_ptr<Local>> Locals;
+
+        // The calling thread's Locals of every ThreadLocalEvent with these
+        // arguments, keyed by the id of the event. A Local is only in the
+        // map while the thread has Binds to the event.
+        static Locals& thread_locals()
+        {
+            static thread_local Locals locals;
+            return locals;
+        }
+
+        static Local* find_local(std::size_t id)
+        {
+            auto& locals = thread_locals();
+            auto found = locals.find(id);
+            return found == locals.end() ? 0 : found->second.get();
+        }
+
+        // Removes local from the calling thread's map once its last Bind is
+        // gone, which destroys it unless something else still holds it.
+        // Other threads stop mailing it once it is destroyed.
+        static void release_local(Local& local)
+        {
+            auto& locals = thread_locals();
+            auto found = locals.find(local.event_id);
+            if (found != locals.end() && found->second.get() == &local)
+            {
+                auto released = std::move(found->second);
+                locals.erase(found);
+            }
+        }
+
+        static std::atomic<std::size_t>& next_event_id()
+        {
+            static std::atomic<std::size_t> id(0);
+            return id;
+        }
+
+        // Ids are never reused, so a Local kept alive by a Bind that
+        // outlives its event is never mistaken for one of a new event.
+        std::size_t id;
+
+        // Guards locals.
+        std::mutex mutex;
+
+        std::vector<std::weak_ptr<Local>> locals;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_THREAD_POOL_HPP
+#define EVENT_THREAD_POOL_HPP
+
+// standard library
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+    A fixed set of threads that run work posted to them in no particular
+    order. Used to execute bound functions in parallel.
+*/
+class EventThreadPool
+{
+    public:
+
+        typedef std::function<void()> Work;
+
+        /*
+            Constructor
+
+            Starts thread_count threads, by default one per hardware thread.
+        =====================================================================*/
+        explicit EventThreadPool(
+            std::size_t thread_count = std::thread::hardware_concurrency()
+        ):
+            stopping(false)
+        {
+            if (thread_count == 0)
+            {
+                thread_count = 1;
+            }
+            for (std::size_t i = 0; i < thread_count; ++i)
+            {
+                this->threads.emplace_back([this]{
+                    this->run();
+                });
+            }
+        }
+
+        /*
+            Destructor
+
+            Finishes the work already posted, then joins the threads.
+        =====================================================================*/
+        ~EventThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->condition.notify_all();
+            for (auto& thread: this->threads)
+            {
+                thread.join();
+            }
+        }
+
+        /*
+            post
+
+            Runs work on one of the threads.
+        =====================================================================*/
+        void post(Work work)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->work.push_back(std::move(work));
+            }
+            this->condition.notify_one();
+        }
+
+        /*
+            size
+
+            The number of threads in the pool.
+        =====================================================================*/
+        std::size_t size() const
+        {
+            return this->threads.size();
+        }
+
+    private:
+
+        EventThreadPool(const EventThreadPool&) = delete;
+
+        EventThreadPool& operator=(const EventThreadPool&) = delete;
+
+        void run()
+        {
+            for (;;)
+            {
+                Work work;
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->condition.wait(lock, [this]{
+                        return this->stopping || !this->work.empty();
+                    });
+                    if (this->work.empty())
+                    {
+                        return;
+                    }
+                    work = std::move(this->work.front());
+                    this->work.pop_front();
+                }
+                work();
+            }
+        }
+
+        std::mutex mutex;
+
+        std::condition_variable condition;
+
+        std::deque<Work> work;
+
+        bool stopping;
+
+        std::vector<std::thread> threads;
+};
+
+#endif
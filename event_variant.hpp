@@ -0,0 +1,610 @@
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2012-2014 Erik Soma
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+#ifndef EVENT_VARIANT_HPP
+#define EVENT_VARIANT_HPP
+
+// standard library
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <variant>
+#endif
+// event
+#include "event.hpp"
+
+namespace event_detail
+{
+    /*
+        IndexOf
+
+        The index of the first occurrence of T in Types.
+    */
+    template <typename T, typename... Types>
+    struct IndexOf;
+
+    template <typename T, typename... Types>
+    struct IndexOf<T, T, Types...>: std::integral_constant<std::size_t, 0>
+    {
+    };
+
+    template <typename T, typename U, typename... Types>
+    struct IndexOf<T, U, Types...>: std::integral_constant<
+        std::size_t,
+        1 + IndexOf<T, Types...>::value
+    >
+    {
+    };
+
+    /*
+        IsDistinct
+
+        True if no type appears in Types more than once.
+    */
+    template <typename... Types>
+    struct IsDistinct: std::true_type
+    {
+    };
+
+    template <typename T, typename... Types>
+    struct IsDistinct<T, Types...>: std::integral_constant<
+        bool,
+        And<!std::is_same<T, Types>::value...>::value &&
+        IsDistinct<Types...>::value
+    >
+    {
+    };
+}
+
+/*
+    An Event for a set of message types, standing in for one Event per type.
+    A bound function subscribes to one or more of the types and receives the
+    message as a const reference. Each type has its own contiguous array of
+    functions, and a firing selects the array through a table indexed by the
+    position of the type, so the cost of a firing does not grow with the
+    number of types.
+
+    Messages are fired by type, by their index among Types with a pointer to
+    the message (for decoders that read a tag before the payload), or in
+    C++17 as a std::variant of Types.
+*/
+template <typename... Types>
+class VariantEvent
+{
+    private:
+
+        static_assert(
+            event_detail::IsDistinct<Types...>::value,
+            "VariantEvent types must be distinct"
+        );
+
+        typedef std::tuple<Types...> TypeList;
+
+        template <std::size_t Index>
+        using Type = typename std::tuple_element<Index, TypeList>::type;
+
+        template <typename T>
+        struct Handler
+        {
+            Handler(std::function<void(const T&)> function, std::uint64_t id):
+                function(std::move(function)),
+                id(id),
+                removed(false)
+            {
+            }
+
+            std::function<void(const T&)> function;
+
+            std::uint64_t id;
+
+            bool removed;
+        };
+
+        /*
+            The functions subscribed to one of the types.
+        */
+        template <typename T>
+        struct Alternative
+        {
+            Alternative():
+                firing(0),
+                dirty(false)
+            {
+            }
+
+            void bind(std::function<void(const T&)> function, std::uint64_t id)
+            {
+                // Functions bound while firing wait in pending, so that the
+                // array being fired is never reallocated.
+                (this->firing ? this->pending : this->handlers).emplace_back(
+                    std::move(function),
+                    id
+                );
+            }
+
+            void unbind(std::uint64_t id)
+            {
+                auto matches = [id](const Handler<T>& handler){
+                    return handler.id == id;
+                };
+                auto found = std::find_if(
+                    this->handlers.begin(),
+                    this->handlers.end(),
+                    matches
+                );
+                if (found == this->handlers.end())
+                {
+                    auto pending = std::find_if(
+                        this->pending.begin(),
+                        this->pending.end(),
+                        matches
+                    );
+                    if (pending != this->pending.end())
+                    {
+                        this->pending.erase(pending);
+                    }
+                }
+                else if (this->firing)
+                {
+                    found->removed = true;
+                    this->dirty = true;
+                }
+                else
+                {
+                    this->handlers.erase(found);
+                }
+            }
+
+            // Unbinds everything while firing, the VariantEvent is being
+            // destroyed.
+            void clear()
+            {
+                for (auto& handler: this->handlers)
+                {
+                    handler.removed = true;
+                }
+                this->dirty = true;
+                this->pending.clear();
+            }
+
+            std::size_t fire(const T& message)
+            {
+                std::size_t executed = 0;
+                auto count = this->handlers.size();
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    auto& handler = this->handlers[i];
+                    if (!handler.removed)
+                    {
+                        handler.function(message);
+                        ++executed;
+                    }
+                }
+                return executed;
+            }
+
+            // Called once the outermost firing has finished.
+            void settle()
+            {
+                if (this->dirty)
+                {
+                    this->handlers.erase(
+                        std::remove_if(
+                            this->handlers.begin(),
+                            this->handlers.end(),
+                            [](const Handler<T>& handler){
+                                return handler.removed;
+                            }
+                        ),
+                        this->handlers.end()
+                    );
+                    this->dirty = false;
+                }
+                for (auto& handler: this->pending)
+                {
+                    this->handlers.push_back(std::move(handler));
+                }
+                this->pending.clear();
+            }
+
+            std::vector<Handler<T>> handlers;
+
+            std::vector<Handler<T>> pending;
+
+            std::size_t firing;
+
+            bool dirty;
+        };
+
+        /*
+            Everything bound to the VariantEvent, shared with the Binds so
+            that they can outlive it.
+        */
+        struct State
+        {
+            State():
+                next_id(0),
+                firing(0)
+            {
+            }
+
+            std::tuple<Alternative<Types>...> alternatives;
+
+            std::uint64_t next_id;
+
+            // The number of firings in progress, of any type.
+            std::size_t firing;
+
+            // Set when the VariantEvent is destroyed while firing, the last
+            // firing lets go of it.
+            std::shared_ptr<State> self;
+        };
+
+        /*
+            Marks an Alternative as firing for the lifetime of the Firing.
+        */
+        template <typename T>
+        class Firing
+        {
+            public:
+
+                Firing(State& state, Alternative<T>& alternative):
+                    state(state),
+                    alternative(alternative)
+                {
+                    ++this->state.firing;
+                    ++this->alternative.firing;
+                }
+
+                ~Firing()
+                {
+                    if (--this->alternative.firing == 0)
+                    {
+                        this->alternative.settle();
+                    }
+                    if (--this->state.firing == 0 && this->state.self)
+                    {
+                        // destroys the State last
+                        auto self = std::move(this->state.self);
+                    }
+                }
+
+            private:
+
+                State& state;
+
+                Alternative<T>& alternative;
+        };
+
+        typedef std::bitset<sizeof...(Types)> Subscriptions;
+
+    public:
+
+        /*
+            An object that has ownership of a bind to a VariantEvent, the
+            function is unsubscribed from all of its types when the Bind is
+            destroyed.
+        */
+        class Bind
+        {
+            public:
+
+                /*
+                    Destructor
+                =============================================================*/
+                ~Bind()
+                {
+                    auto state = this->state.lock();
+                    if (!state)
+                    {
+                        return;
+                    }
+                    for (std::size_t i = 0; i < sizeof...(Types); ++i)
+                    {
+                        if (this->subscriptions[i])
+                        {
+                            VariantEvent::table().unbind[i](*state, this->id);
+                        }
+                    }
+                }
+
+            private:
+
+                friend class VariantEvent<Types...>;
+
+                /*
+                    Constructor
+                =============================================================*/
+                Bind(
+                    const std::shared_ptr<State>& state,
+                    std::uint64_t id,
+                    Subscriptions subscriptions
+                ):
+                    state(state),
+                    id(id),
+                    subscriptions(subscriptions)
+                {
+                }
+
+                std::weak_ptr<State> state;
+
+                std::uint64_t id;
+
+                Subscriptions subscriptions;
+        };
+
+        /*
+            Constructor
+        =====================================================================*/
+        VariantEvent():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /*
+            Destructor
+        =====================================================================*/
+        ~VariantEvent()
+        {
+            if (this->state->firing)
+            {
+                for (std::size_t i = 0; i < sizeof...(Types); ++i)
+                {
+                    table().clear[i](*this->state);
+                }
+                this->state->self = std::move(this->state);
+            }
+        }
+
+        /*
+            bind
+
+            Subscribes function to the messages of each of Subscribed, which
+            must be distinct and among Types, for the duration of the Bind
+            returned. The function is shared by all of the types rather than
+            copied:
+
+                auto bind = event.bind<Login, Logout>([](const auto& message){
+                    // ...
+                });
+        =====================================================================*/
+        template <typename... Subscribed, typename Function>
+        std::shared_ptr<Bind> bind(Function function)
+        {
+            static_assert(
+                sizeof...(Subscribed) > 0,
+                "bind must subscribe to at least one type"
+            );
+            // a Bind tracks one subscription per type
+            static_assert(
+                event_detail::IsDistinct<Subscribed...>::value,
+                "bind must subscribe to each type at most once"
+            );
+            auto shared = std::make_shared<Function>(std::move(function));
+            auto id = this->state->next_id++;
+            Subscriptions subscriptions;
+            const int expand[] = {0, (
+                this->subscribe<Subscribed>(shared, id, subscriptions),
+                0
+            )...};
+            (void)expand;
+            return std::shared_ptr<Bind>(
+                new Bind(this->state, id, subscriptions)
+            );
+        }
+
+        /*
+            has_handlers
+
+            Returns true if at least one function is subscribed to T.
+        =====================================================================*/
+        template <typename T>
+        bool has_handlers() const
+        {
+            auto& alternative = std::get<
+                event_detail::IndexOf<T, Types...>::value
+            >(this->state->alternatives);
+            for (auto& handler: alternative.handlers)
+            {
+                if (!handler.removed)
+                {
+                    return true;
+                }
+            }
+            return !alternative.pending.empty();
+        }
+
+        /*
+            fire
+
+            Executes the functions subscribed to the type of message. Returns
+            the number of functions executed.
+        =====================================================================*/
+        template <typename T>
+        std::size_t fire(const T& message)
+        {
+            return this->fire_at<event_detail::IndexOf<T, Types...>::value>(
+                message
+            );
+        }
+
+        /*
+            fire
+
+            Executes the functions subscribed to the type at index in Types,
+            where message points to a value of that type. Returns the number
+            of functions executed.
+        =====================================================================*/
+        std::size_t fire(std::size_t index, const void* message)
+        {
+            assert(index < sizeof...(Types));
+            return table().fire[index](*this, message);
+        }
+
+#if __cplusplus >= 201703L
+        /*
+            fire
+
+            Executes the functions subscribed to the type message holds.
+            Returns the number of functions executed.
+        =====================================================================*/
+        std::size_t fire(const std::variant<Types...>& message)
+        {
+            if (message.valueless_by_exception())
+            {
+                return 0;
+            }
+            return table().fire_variant[message.index()](*this, message);
+        }
+#endif
+
+    private:
+
+        VariantEvent(const VariantEvent&) = delete;
+
+        VariantEvent& operator=(const VariantEvent&) = delete;
+
+        /*
+            One entry per type for each operation that is selected by the
+            index of a type at run time.
+        */
+        struct Table
+        {
+            std::size_t (*fire[sizeof...(Types)])(VariantEvent&, const void*);
+
+#if __cplusplus >= 201703L
+            std::size_t (*fire_variant[sizeof...(Types)])(
+                VariantEvent&,
+                const std::variant<Types...>&
+            );
+#endif
+
+            void (*unbind[sizeof...(Types)])(State&, std::uint64_t);
+
+            void (*clear[sizeof...(Types)])(State&);
+        };
+
+        // Constant initialized, so using it is a plain indexed load.
+        static const Table& table()
+        {
+            return table(
+                typename event_detail::MakeIndexSequence<
+                    sizeof...(Types)
+                >::Type()
+            );
+        }
+
+        template <std::size_t... Indices>
+        static const Table& table(event_detail::IndexSequence<Indices...>)
+        {
+            static const Table table = {
+                {&VariantEvent::fire_pointer<Indices>...},
+#if __cplusplus >= 201703L
+                {&VariantEvent::fire_alternative<Indices>...},
+#endif
+                {&VariantEvent::unbind_at<Indices>...},
+                {&VariantEvent::clear_at<Indices>...}
+            };
+            return table;
+        }
+
+        template <typename T, typename Function>
+        void subscribe(
+            const std::shared_ptr<Function>& shared,
+            std::uint64_t id,
+            Subscriptions& subscriptions
+        )
+        {
+            const auto index = event_detail::IndexOf<T, Types...>::value;
+            std::get<index>(this->state->alternatives).bind(
+                [shared](const T& message){
+                    (*shared)(message);
+                },
+                id
+            );
+            subscriptions.set(index);
+        }
+
+        template <std::size_t Index>
+        std::size_t fire_at(const Type<Index>& message)
+        {
+            auto& state = *this->state;
+            auto& alternative = std::get<Index>(state.alternatives);
+            if (alternative.handlers.empty())
+            {
+                return 0;
+            }
+            Firing<Type<Index>> firing(state, alternative);
+            return alternative.fire(message);
+        }
+
+        template <std::size_t Index>
+        static std::size_t fire_pointer(
+            VariantEvent& event,
+            const void* message
+        )
+        {
+            return event.fire_at<Index>(
+                *static_cast<const Type<Index>*>(message)
+            );
+        }
+
+#if __cplusplus >= 201703L
+        template <std::size_t Index>
+        static std::size_t fire_alternative(
+            VariantEvent& event,
+            const std::variant<Types...>& message
+        )
+        {
+            return event.fire_at<Index>(*std::get_if<Index>(&message));
+        }
+#endif
+
+        template <std::size_t Index>
+        static void unbind_at(State& state, std::uint64_t id)
+        {
+            std::get<Index>(state.alternatives).unbind(id);
+        }
+
+        template <std::size_t Index>
+        static void clear_at(State& state)
+        {
+            std::get<Index>(state.alternatives).clear();
+        }
+
+        std::shared_ptr<State> state;
+};
+
+#endif
@@ -26,12 +26,103 @@ THE SOFTWARE.
 
 // standard library
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 // event
 #include "event.hpp"
+#include "event_codec.hpp"
+#include "event_concurrent.hpp"
+#include "event_fiber.hpp"
+#include "event_future.hpp"
+#include "event_graph.hpp"
+#include "event_hierarchy.hpp"
+#include "event_noexcept.hpp"
+#include "event_realtime.hpp"
+#include "event_route.hpp"
+#include "event_record.hpp"
+#include "event_sender.hpp"
+#include "event_set.hpp"
+#include "event_sharded.hpp"
+#include "event_simulation.hpp"
+#include "event_table.hpp"
+#include "event_thread_local.hpp"
+#include "event_variant.hpp"
 
 static void test_basic_operations();
 static void test_arguments();
+static void test_fire_lazy();
+static void test_move();
+static void test_destroy_while_firing();
+static void test_trackable();
+static void test_bind_once();
+static void test_bind_many();
+static void test_fire_context();
+static void test_exception_policies();
+static void test_subrate();
+static void test_codec();
+static void test_record();
+static void test_simulation();
+static void test_table();
+static void test_variant();
+static void test_set();
+static void test_route();
+static void test_graph();
+static void test_hierarchy();
+static void test_realtime();
+static void test_sharded();
+static void test_thread_local();
+static void test_concurrent();
+static void test_fiber();
+static void test_sender();
+static void test_future();
+
+/*
+    Allocations are counted on threads that mark themselves as realtime, to
+    check that nothing allocates there.
+*/
+static thread_local bool realtime_thread = false;
+static std::atomic<std::size_t> realtime_allocations(0);
+
+void* operator new(std::size_t size)
+{
+    if (realtime_thread)
+    {
+        ++realtime_allocations;
+    }
+    auto memory = std::malloc(size ? size : 1);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    if (memory && realtime_thread)
+    {
+        ++realtime_allocations;
+    }
+    std::free(memory);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void* memory, std::size_t) noexcept
+{
+    operator delete(memory);
+}
+#endif
 
 /*
     This program tests the Event.
@@ -40,11 +131,40 @@ int main(int argc, const char* argv[])
 {
     test_basic_operations();
     test_arguments();
+    test_fire_lazy();
+    test_move();
+    test_destroy_while_firing();
+    test_trackable();
+    test_bind_once();
+    test_bind_many();
+    test_fire_context();
+    test_exception_policies();
+    test_subrate();
+    test_codec();
+    test_record();
+    test_simulation();
+    test_table();
+    test_variant();
+    test_set();
+    test_route();
+    test_graph();
+    test_hierarchy();
+    test_realtime();
+    test_sharded();
+    test_thread_local();
+    test_concurrent();
+    test_fiber();
+    test_sender();
+    test_future();
     return EXIT_SUCCESS;
 }
 
 static void test_basic_operations()
 {
+    // an Event that has never been bound to is a single pointer
+    static_assert(sizeof(Event<>) == sizeof(void*), "");
+    static_assert(sizeof(Event<int, const std::string&>) == sizeof(void*), "");
+    
     Event<> event;
     event.fire();
     
@@ -134,4 +254,2208 @@ static void test_arguments()
     });
     event.fire(a, b, c);
     assert(executed);
-}
\ No newline at end of file
+}
+
+static void test_fire_lazy()
+{
+    Event<const std::string&> event;
+    assert(!event.has_handlers());
+    
+    std::size_t factory_calls = 0;
+    auto factory = [&]{
+        ++factory_calls;
+        return std::string("expensive");
+    };
+    
+    // nothing is built when nobody is listening
+    assert(event.fire_lazy(factory) == 0);
+    assert(factory_calls == 0);
+    
+    std::size_t executed = 0;
+    auto function = [&](const std::string& value){
+        assert(value == "expensive");
+        ++executed;
+    };
+    auto bind_a = event.bind(function);
+    auto bind_b = event.bind(function);
+    auto bind_c = event.bind(function);
+    assert(event.has_handlers());
+    
+    // the arguments are built once no matter how many functions are bound
+    assert(event.fire_lazy(factory) == 3);
+    assert(factory_calls == 1);
+    assert(executed == 3);
+    
+    bind_a = 0;
+    bind_b = 0;
+    bind_c = 0;
+    assert(!event.has_handlers());
+    assert(event.fire_lazy(factory) == 0);
+    assert(factory_calls == 1);
+    
+    // several arguments are built as a tuple
+    Event<int, int&, const int&> tuple_event;
+    auto tuple_executed = false;
+    tuple_event.permanent_bind([&](int a, int& b, const int& c){
+        tuple_executed = true;
+        assert(a == 1);
+        assert(b == 2);
+        assert(c == 3);
+        b = 4;
+    });
+    assert(tuple_event.has_handlers());
+    assert(tuple_event.fire_lazy([]{ return std::make_tuple(1, 2, 3); }) == 1);
+    assert(tuple_executed);
+}
+
+static void test_move()
+{
+    // Events can live directly in a vector, binds follow them as the vector
+    // grows
+    std::vector<Event<int>> events(1);
+    std::vector<int> fired;
+    auto bind = events[0].bind([&](int value){
+        fired.push_back(value);
+    });
+    events[0].permanent_bind([&](int value){
+        fired.push_back(-value);
+    });
+    for (int i = 0; i < 100; ++i)
+    {
+        events.emplace_back();
+    }
+    assert(events[0].fire(1) == 2);
+    assert(fired == std::vector<int>({1, -1}));
+    
+    Event<int> moved(std::move(events[0]));
+    assert(!events[0].has_handlers());
+    assert(events[0].fire(2) == 0);
+    assert(moved.fire(3) == 2);
+    assert(fired == std::vector<int>({1, -1, 3, -3}));
+    
+    // unbinding after a move unbinds from the moved to Event
+    bind = 0;
+    assert(moved.fire(4) == 1);
+    assert(fired == std::vector<int>({1, -1, 3, -3, -4}));
+    
+    // move assignment unbinds whatever was bound to the target
+    Event<int> target;
+    auto target_bind = target.bind([&](int){
+        assert(false);
+    });
+    target = std::move(moved);
+    assert(target.fire(5) == 1);
+    assert(fired == std::vector<int>({1, -1, 3, -3, -4, -5}));
+    target_bind = 0;
+    assert(target.fire(6) == 1);
+}
+
+static void test_destroy_while_firing()
+{
+    std::unique_ptr<Event<>> event(new Event<>());
+    auto function_a_var = false;
+    auto bind = event->bind([&]{
+        function_a_var = true;
+        event.reset();
+    });
+    event->permanent_bind([&]{
+        assert(false);
+    });
+    assert(event->fire() == 1);
+    assert(function_a_var);
+    assert(!event);
+    // the bind outlived the Event
+    bind = 0;
+    
+    // a function may own the Bind of a later function of the same Event,
+    // which is destroyed along with it
+    {
+        std::unique_ptr<Event<>> owner(new Event<>());
+        auto later = std::make_shared<std::shared_ptr<Event<>::Bind>>();
+        owner->permanent_bind([later]{
+        });
+        *later = owner->bind([]{
+        });
+        auto last = owner->bind([]{
+        });
+        later.reset();
+        owner.reset();
+    }
+}
+
+namespace
+{
+    class Listener: public Trackable
+    {
+        public:
+        
+            Listener():
+                total(0)
+            {
+            }
+            
+            void on_value(int value)
+            {
+                this->total += value;
+            }
+            
+            void on_const_value(int value) const
+            {
+                assert(value == 1);
+            }
+            
+            int total;
+    };
+}
+
+static void test_trackable()
+{
+    Event<int> event_a;
+    Event<int> event_b;
+    {
+        Listener listener;
+        event_a.bind(listener, &Listener::on_value);
+        event_b.bind(listener, &Listener::on_value);
+        event_a.bind(listener, &Listener::on_const_value);
+        event_b.bind(listener, [&](int value){
+            listener.total += value * 10;
+        });
+        assert(event_a.fire(1) == 2);
+        assert(event_b.fire(2) == 2);
+        assert(listener.total == 1 + 2 + 20);
+        
+        // a copy does not take over the binds of the original
+        Listener copy(listener);
+        assert(event_a.fire(1) == 2);
+    }
+    // destroying the listener unbound everything made on its behalf
+    assert(!event_a.has_handlers());
+    assert(!event_b.has_handlers());
+    assert(event_a.fire(1) == 0);
+    
+    // the listener may outlive the Event
+    Listener listener;
+    {
+        Event<int> event;
+        event.bind(listener, &Listener::on_value);
+        event.fire(5);
+    }
+    assert(listener.total == 5);
+    
+    // and may be destroyed while the Event is firing
+    std::unique_ptr<Listener> owned(new Listener());
+    event_a.bind(*owned, [&](int){
+        owned.reset();
+    });
+    event_a.bind(*owned, [&](int){
+        assert(false);
+    });
+    assert(event_a.fire(1) == 1);
+    assert(!event_a.has_handlers());
+    
+    // binds can be dropped early
+    event_a.bind(listener, &Listener::on_value);
+    listener.disconnect_all();
+    assert(event_a.fire(1) == 0);
+}
+
+static void test_bind_once()
+{
+    Event<int> event;
+    std::vector<int> fired;
+    event.bind_once([&](int value){
+        fired.push_back(value);
+        // firing again from inside does not execute it a second time
+        event.fire(value + 1);
+    });
+    assert(event.has_handlers());
+    assert(event.fire(1) == 1);
+    assert(fired == std::vector<int>({1}));
+    assert(!event.has_handlers());
+    assert(event.fire(3) == 0);
+    
+    // once binds made on behalf of a Trackable
+    {
+        Listener listener;
+        event.bind_once(listener, &Listener::on_value);
+        event.bind_once(listener, &Listener::on_value);
+        assert(event.fire(2) == 2);
+        assert(listener.total == 4);
+        event.bind_once(listener, &Listener::on_value);
+    }
+    assert(!event.has_handlers());
+    
+    // when_any executes on the first of the events and unbinds from the rest
+    Event<> event_a;
+    Event<int, const std::string&> event_b;
+    int any_count = 0;
+    when_any([&]{ ++any_count; }, event_a, event_b);
+    assert(event_a.has_handlers());
+    assert(event_b.has_handlers());
+    event_b.fire(1, "b");
+    assert(any_count == 1);
+    assert(!event_a.has_handlers());
+    assert(!event_b.has_handlers());
+    event_a.fire();
+    assert(any_count == 1);
+    
+    // when_all executes once every event has fired
+    int all_count = 0;
+    when_all([&]{ ++all_count; }, event_a, event_b);
+    event_a.fire();
+    event_a.fire();
+    assert(all_count == 0);
+    event_b.fire(2, "b");
+    assert(all_count == 1);
+    assert(!event_a.has_handlers());
+    assert(!event_b.has_handlers());
+    
+    // a function executed once may own the Bind of a later function, which
+    // is unbound when the first is destroyed after the firing
+    {
+        Event<> event;
+        auto later = std::make_shared<std::shared_ptr<Event<>::Bind>>();
+        int executed = 0;
+        event.bind_once([later, &executed]{
+            ++executed;
+        });
+        *later = event.bind([&executed]{
+            ++executed;
+        });
+        auto last = event.bind([&executed]{
+            ++executed;
+        });
+        later.reset();
+        assert(event.fire() == 3);
+        assert(event.fire() == 1);
+        assert(executed == 4);
+    }
+}
+
+static void test_bind_many()
+{
+    Event<int> event;
+    event.reserve(10);
+    std::vector<int> fired;
+    std::vector<std::function<void(int)>> functions;
+    for (int i = 0; i < 5; ++i)
+    {
+        functions.push_back([&fired, i](int value){
+            fired.push_back(value + i);
+        });
+    }
+    {
+        auto group = event.bind_many(functions);
+        assert(group.size() == 5);
+        assert(event.fire(10) == 5);
+        assert(fired == std::vector<int>({10, 11, 12, 13, 14}));
+        
+        group.unbind(1);
+        assert(!group.is_bound(1));
+        assert(group.is_bound(2));
+        fired.clear();
+        assert(event.fire(10) == 4);
+        assert(fired == std::vector<int>({10, 12, 13, 14}));
+        
+        // groups can be moved
+        auto moved = std::move(group);
+        assert(event.fire(10) == 4);
+    }
+    // destroying the group unbinds everything in it
+    assert(!event.has_handlers());
+    
+    // the group may outlive the Event
+    Event<int>::BindGroup* outliving = 0;
+    {
+        Event<int> short_lived;
+        outliving = new Event<int>::BindGroup(short_lived.bind_many(functions));
+        assert(outliving->is_bound(0));
+    }
+    assert(!outliving->is_bound(0));
+    delete outliving;
+}
+
+namespace
+{
+    struct Point
+    {
+        Point(int x, int y): x(x), y(y)
+        {
+        }
+        
+        // not trivially copyable, so it needs EventCodecTraits of its own
+        Point(const Point& other): x(other.x), y(other.y)
+        {
+        }
+        
+        int x;
+        int y;
+    };
+}
+
+template <>
+struct EventCodecTraits<Point>
+{
+    typedef Point Decoded;
+    
+    static std::size_t size(const Point&)
+    {
+        return 2 * sizeof(int);
+    }
+    
+    static void encode(unsigned char*& out, const Point& value)
+    {
+        EventCodecTraits<int>::encode(out, value.x);
+        EventCodecTraits<int>::encode(out, value.y);
+    }
+    
+    static Decoded decode(const unsigned char*& in, const unsigned char* end)
+    {
+        int x = EventCodecTraits<int>::decode(in, end);
+        int y = EventCodecTraits<int>::decode(in, end);
+        return Point(x, y);
+    }
+};
+
+static void test_fire_context()
+{
+    Event<int> event;
+    int total = 0;
+    std::vector<std::shared_ptr<Event<int>::Bind>> binds;
+    for (auto i = 0; i < 10; ++i)
+    {
+        binds.push_back(event.bind([&total](int value){
+            total += value;
+            // handlers stop the firing through the current context
+            if (total == 3)
+            {
+                FireContext::current()->stop();
+            }
+        }));
+    }
+    assert(!FireContext::current());
+    
+    FireContext context;
+    assert(event.fire(context, 1) == 3);
+    assert(total == 3);
+    assert(context.stopped());
+    assert(!FireContext::current());
+    // a stopped context executes nothing
+    assert(event.fire(context, 1) == 0);
+    assert(total == 3);
+    // plain firing is unaffected
+    assert(event.fire(1) == 10);
+    assert(total == 13);
+    
+    // nested firings see their own context and restore the outer one
+    Event<> outer;
+    FireContext outer_context;
+    auto outer_bind = outer.bind([&]{
+        assert(FireContext::current() == &outer_context);
+        FireContext inner_context;
+        total = 0;
+        assert(event.fire(inner_context, 1) == 3);
+        assert(FireContext::current() == &outer_context);
+    });
+    auto outer_after = outer.bind([]{
+    });
+    assert(outer.fire(outer_context) == 2);
+    assert(!outer_context.stopped());
+    
+#if __cplusplus >= 202002L
+    std::stop_source source;
+    total = 0;
+    auto requester = event.bind([&](int){
+        source.request_stop();
+    });
+    binds.erase(binds.begin() + 1, binds.end());
+    auto after = event.bind([](int){
+        assert(false);
+    });
+    assert(event.fire(source.get_token(), 10) == 2);
+#endif
+}
+
+static void test_exception_policies()
+{
+    // an isolated firing executes every function and throws their
+    // exceptions together
+    {
+        Event<int> event;
+        std::vector<int> executed;
+        auto a = event.bind([&](int){
+            executed.push_back(0);
+            throw std::runtime_error("a");
+        });
+        auto b = event.bind([&](int){
+            executed.push_back(1);
+        });
+        auto c = event.bind([&](int value){
+            executed.push_back(2);
+            throw value;
+        });
+        bool thrown = false;
+        try
+        {
+            event.fire_isolated(7);
+        }
+        catch (const EventErrors& errors)
+        {
+            thrown = true;
+            assert(errors.errors().size() == 2);
+            try
+            {
+                std::rethrow_exception(errors.errors()[0]);
+            }
+            catch (const std::runtime_error& error)
+            {
+                assert(std::string(error.what()) == "a");
+            }
+            try
+            {
+                std::rethrow_exception(errors.errors()[1]);
+            }
+            catch (int value)
+            {
+                assert(value == 7);
+            }
+        }
+        assert(thrown);
+        assert((executed == std::vector<int>{0, 1, 2}));
+        
+        // nothing is thrown when no function throws
+        a = 0;
+        c = 0;
+        assert(event.fire_isolated(1) == 1);
+        Event<int> unbound;
+        assert(unbound.fire_isolated(1) == 0);
+    }
+    
+    // a NoexceptEvent behaves like an Event for functions that cannot throw
+    {
+        NoexceptEvent<int, const std::string&> event;
+        assert(!event.has_handlers());
+        std::vector<int> executed;
+        std::shared_ptr<NoexceptEvent<int, const std::string&>::Bind> late;
+        auto a = event.bind([&](int value, const std::string&) noexcept {
+            executed.push_back(value);
+            // functions bound while firing execute from the next firing
+            if (!late)
+            {
+                late = event.bind([&](int, const std::string&) noexcept {
+                    executed.push_back(-1);
+                });
+            }
+        });
+        std::shared_ptr<NoexceptEvent<int, const std::string&>::Bind> b;
+        b = event.bind([&](int value, const std::string&) noexcept {
+            executed.push_back(value * 10);
+            b = 0;
+        });
+        assert(event.has_handlers());
+        assert(event.fire(1, "") == 2);
+        assert((executed == std::vector<int>{1, 10}));
+        assert(event.fire(2, "") == 2);
+        assert((executed == std::vector<int>{1, 10, 2, -1}));
+        late = 0;
+        a = 0;
+        assert(!event.has_handlers());
+        assert(event.fire(3, "") == 0);
+    }
+    
+    // the space for functions bound while firing is reserved as they are
+    // bound, so settling at the end of the firing does not allocate
+    {
+        NoexceptEvent<> event;
+        std::vector<std::shared_ptr<NoexceptEvent<>::Bind>> binds;
+        int executed = 0;
+        auto binder = event.bind([&]() noexcept {
+            if (binds.empty())
+            {
+                for (auto i = 0; i < 50; ++i)
+                {
+                    binds.push_back(event.bind([&]() noexcept {
+                        ++executed;
+                    }));
+                }
+                // count what the rest of the firing allocates
+                realtime_thread = true;
+            }
+        });
+        auto allocations = realtime_allocations.load();
+        assert(event.fire() == 1);
+        realtime_thread = false;
+        assert(realtime_allocations == allocations);
+        assert(executed == 0);
+        assert(event.fire() == 51);
+        assert(executed == 50);
+    }
+    
+    // a NoexceptEvent may be destroyed while firing
+    {
+        std::unique_ptr<NoexceptEvent<>> event(new NoexceptEvent<>());
+        int executed = 0;
+        auto a = event->bind([&]() noexcept {
+            ++executed;
+            event.reset();
+        });
+        auto b = event->bind([&]() noexcept {
+            ++executed;
+        });
+        assert(event->fire() == 1);
+        assert(executed == 1);
+    }
+}
+
+static void test_subrate()
+{
+    Event<int> event;
+    
+    // a decimated function executes on every nth firing
+    std::vector<int> decimated;
+    auto every_third = event.bind_decimated(3, [&](int value){
+        decimated.push_back(value);
+    });
+    int every = 0;
+    auto all = event.bind_decimated(1, [&](int){
+        ++every;
+    });
+    for (int i = 1; i <= 10; ++i)
+    {
+        event.fire(i);
+    }
+    assert((decimated == std::vector<int>{3, 6, 9}));
+    assert(every == 10);
+    // skipped firings do not count as executions
+    assert(event.fire(11) == 1);
+    assert(event.fire(12) == 2);
+    every_third = 0;
+    all = 0;
+    assert(!event.has_handlers());
+    
+    // a sampled function executes on roughly the given share of firings
+    int sampled = 0;
+    int always = 0;
+    auto tenth = event.bind_sampled(0.1, [&](int){
+        ++sampled;
+    });
+    auto certain = event.bind_sampled(1.0, [&](int){
+        ++always;
+    });
+    for (int i = 0; i < 100000; ++i)
+    {
+        event.fire(i);
+    }
+    assert(sampled > 9000 && sampled < 11000);
+    assert(always == 100000);
+    
+    // rates that are out of range are rejected
+    bool thrown = false;
+    try
+    {
+        event.bind_decimated(0, [](int){});
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try
+    {
+        event.bind_sampled(0.0, [](int){});
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+static void test_codec()
+{
+    static_assert(EventCodec<int, const double&, char>::is_fixed_size, "");
+    static_assert(!EventCodec<int, std::string>::is_fixed_size, "");
+#if __cplusplus >= 201703L
+    static_assert(!EventCodec<int, std::string_view>::is_fixed_size, "");
+#endif
+#if __cplusplus >= 202002L
+    static_assert(
+        !EventCodec<std::span<const unsigned char>>::is_fixed_size,
+        ""
+    );
+#endif
+    
+    // trivially copyable arguments are packed back to back
+    {
+        typedef EventCodec<int, const double&, char> Codec;
+        assert(Codec::size(1, 2.0, 'c') == sizeof(int) + sizeof(double) + 1);
+        std::vector<unsigned char> buffer(Codec::size(1, 2.0, 'c'));
+        auto end = Codec::encode(buffer.data(), 1, 2.0, 'c');
+        assert(end == buffer.data() + buffer.size());
+        auto executed = false;
+        auto decoded_end = Codec::decode(
+            buffer.data(),
+            end,
+            [&](int a, const double& b, char c){
+                executed = true;
+                assert(a == 1);
+                assert(b == 2.0);
+                assert(c == 'c');
+                // aligned values are viewed in place
+                if (reinterpret_cast<std::uintptr_t>(&buffer[4]) % 8 == 0)
+                {
+                    assert(&b == reinterpret_cast<const double*>(&buffer[4]));
+                }
+            }
+        );
+        assert(executed);
+        assert(decoded_end == end);
+    }
+    
+    // variable sized and user defined arguments
+    {
+        typedef EventCodec<
+            const std::string&,
+            std::vector<int>&,
+            const std::vector<std::string>&,
+            Point
+        > Codec;
+        std::string text = "hello world";
+        std::vector<int> numbers = {1, 2, 3};
+        std::vector<std::string> words = {"a", "", "abc"};
+        std::vector<unsigned char> buffer(
+            Codec::size(text, numbers, words, Point(4, 5))
+        );
+        auto end = Codec::encode(
+            buffer.data(),
+            text,
+            numbers,
+            words,
+            Point(4, 5)
+        );
+        assert(end == buffer.data() + buffer.size());
+        
+        Event<
+            const std::string&,
+            std::vector<int>&,
+            const std::vector<std::string>&,
+            Point
+        > event;
+        auto executed = false;
+        auto bind = event.bind([&](
+            const std::string& a,
+            std::vector<int>& b,
+            const std::vector<std::string>& c,
+            Point d
+        ){
+            executed = true;
+            assert(a == text);
+            assert(b == numbers);
+            assert(c == words);
+            assert(d.x == 4 && d.y == 5);
+            // non-const references get an object of their own
+            b.push_back(4);
+        });
+        assert(Codec::fire(event, buffer.data(), end) == end);
+        assert(executed);
+        
+        // truncated input is rejected
+        auto threw = false;
+        try
+        {
+            Codec::fire(event, buffer.data(), end - 1);
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+    
+    // a length prefix so large that its size in bytes overflows is rejected
+    // rather than wrapping around
+    {
+        // 2^62 + 1 ints, which is 4 bytes once multiplied out
+        const unsigned char huge[] = {
+            0x81, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x40, 0, 0, 0, 0
+        };
+        typedef EventCodec<const std::vector<int>&> Codec;
+        Event<const std::vector<int>&> event;
+        auto threw = false;
+        try
+        {
+            Codec::fire(event, huge, huge + sizeof(huge));
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert(threw);
+#if __cplusplus >= 202002L
+        struct Pair
+        {
+            unsigned char first;
+            unsigned char second;
+        };
+        // 2^63 + 1 pairs, which is 2 bytes once multiplied out
+        const unsigned char huge_span[] = {
+            0x81, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 0, 0
+        };
+        typedef EventCodec<std::span<const Pair>> SpanCodec;
+        Event<std::span<const Pair>> span_event;
+        threw = false;
+        try
+        {
+            SpanCodec::fire(
+                span_event,
+                huge_span,
+                huge_span + sizeof(huge_span)
+            );
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert(threw);
+#endif
+    }
+    
+#if __cplusplus >= 201703L
+    // string views refer directly into the buffer
+    {
+        typedef EventCodec<std::string_view> Codec;
+        std::vector<unsigned char> buffer(Codec::size("view"));
+        auto end = Codec::encode(buffer.data(), "view");
+        auto executed = false;
+        Codec::decode(buffer.data(), end, [&](std::string_view view){
+            executed = true;
+            assert(view == "view");
+            assert(
+                view.data() == reinterpret_cast<const char*>(&buffer[1])
+            );
+        });
+        assert(executed);
+    }
+#endif
+}
+
+static void test_record()
+{
+    const std::string path = "event_test_record.log";
+    Event<int, const double&, char> event;
+    {
+        // small segments so that the log is rotated
+        EventRecorder<int, const double&, char> recorder(event, path, 256);
+        for (int i = 0; i < 100; ++i)
+        {
+            event.fire(i, i * 0.5, 'a' + (i % 26));
+        }
+        assert(recorder.record_count() == 100);
+        assert(recorder.segment_count() > 1);
+    }
+    // no longer recording
+    event.fire(-1, 0, 'z');
+    
+    std::vector<int> replayed;
+    auto bind = event.bind([&](int i, const double& d, char c){
+        assert(d == i * 0.5);
+        assert(c == 'a' + (i % 26));
+        replayed.push_back(i);
+    });
+    EventReplayer<int, const double&, char> replayer(path);
+    assert(replayer.replay(event) == 100);
+    assert(replayed.size() == 100);
+    for (int i = 0; i < 100; ++i)
+    {
+        assert(replayed[i] == i);
+    }
+    bind = 0;
+    
+    // variable sized arguments
+    Event<const std::string&> string_event;
+    {
+        EventRecorder<const std::string&> recorder(string_event, path, 64);
+        for (int i = 0; i < 10; ++i)
+        {
+            string_event.fire(std::string(i * 10, 'x'));
+        }
+    }
+    std::size_t string_count = 0;
+    auto string_bind = string_event.bind([&](const std::string& value){
+        assert(value == std::string(string_count * 10, 'x'));
+        ++string_count;
+    });
+    EventReplayer<const std::string&> string_replayer(path);
+    assert(string_replayer.replay(string_event) == 10);
+    assert(string_count == 10);
+    
+    // recorded pacing preserves the spacing between firings
+    Event<> paced_event;
+    {
+        EventRecorder<> recorder(paced_event, path);
+        paced_event.fire();
+        auto wait_until = (
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(20)
+        );
+        while (std::chrono::steady_clock::now() < wait_until);
+        paced_event.fire();
+    }
+    std::vector<std::chrono::steady_clock::time_point> times;
+    auto paced_bind = paced_event.bind([&]{
+        times.push_back(std::chrono::steady_clock::now());
+    });
+    EventReplayer<> paced_replayer(path);
+    auto replay_start = std::chrono::steady_clock::now();
+    assert(
+        paced_replayer.replay(paced_event, EventReplayPacing::recorded) == 2
+    );
+    assert(times.size() == 2);
+    assert(times[1] - replay_start >= std::chrono::milliseconds(20));
+    
+    for (std::size_t i = 0;; ++i)
+    {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".%08u", unsigned(i));
+        if (std::remove((path + suffix).c_str()) != 0)
+        {
+            break;
+        }
+    }
+}
+
+
+static std::vector<int> simulate_interleaving(std::uint64_t seed)
+{
+    SimulationExecutor executor(seed);
+    Event<int> event;
+    std::vector<int> order;
+    event.permanent_bind([&](int value){
+        order.push_back(value);
+    });
+    // four "threads" each delivering ten values
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            executor.fire_on(
+                lane,
+                std::chrono::seconds(0),
+                event,
+                lane * 10 + i
+            );
+        }
+    }
+    executor.run();
+    assert(order.size() == 40);
+    // each lane is delivered in order
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        int last = -1;
+        for (auto value: order)
+        {
+            if (value / 10 == lane)
+            {
+                assert(value > last);
+                last = value;
+            }
+        }
+    }
+    return order;
+}
+
+static void test_simulation()
+{
+    // an hour of a 100Hz timer firing an event with two functions bound
+    SimulationExecutor executor;
+    Event<int> tick;
+    std::size_t ticks = 0;
+    tick.permanent_bind([&](int){ ++ticks; });
+    tick.permanent_bind([&](int){});
+    std::function<void()> timer = [&]{
+        executor.fire(tick, 0);
+        executor.post_after(std::chrono::milliseconds(10), timer);
+    };
+    executor.post_after(std::chrono::milliseconds(10), timer);
+    executor.run_for(std::chrono::hours(1));
+    assert(executor.now().time_since_epoch() == std::chrono::hours(1));
+    assert(ticks == 360000);
+    
+    auto report = executor.report();
+    assert(report.simulated == std::chrono::hours(1));
+    assert(report.fires == 360000);
+    assert(report.handler_invocations == 720000);
+    assert(report.fires_per_second() == 100);
+    assert(report.handler_invocations_per_second() == 200);
+    
+    // work due at the same time on different lanes is interleaved by seed
+    assert(simulate_interleaving(1) == simulate_interleaving(1));
+    assert(simulate_interleaving(1) != simulate_interleaving(2));
+}
+
+
+namespace
+{
+    enum class EntityEvent
+    {
+        moved,
+        damaged,
+        died
+    };
+}
+
+template <>
+struct EventTableEntry<EntityEvent, EntityEvent::moved>:
+    EventTableSignature<int, int>
+{
+};
+
+template <>
+struct EventTableEntry<EntityEvent, EntityEvent::damaged>:
+    EventTableSignature<float>
+{
+};
+
+template <>
+struct EventTableEntry<EntityEvent, EntityEvent::died>:
+    EventTableSignature<>
+{
+};
+
+static void test_table()
+{
+    static_assert(sizeof(EventTable<EntityEvent>) == sizeof(void*), "");
+    
+    EventTable<EntityEvent> table;
+    // firing events that do not exist creates nothing
+    assert(table.fire<EntityEvent::moved>(1, 2) == 0);
+    assert(table.fire<EntityEvent::died>() == 0);
+    assert(!table.has_handlers<EntityEvent::moved>());
+    assert(!table.find<EntityEvent::moved>());
+    assert(table.size() == 0);
+    
+    auto died = false;
+    auto died_bind = table.bind<EntityEvent::died>([&]{ died = true; });
+    float damage = 0;
+    auto damaged_bind = table.bind<EntityEvent::damaged>([&](float value){
+        damage += value;
+    });
+    assert(table.size() == 2);
+    assert(!table.find<EntityEvent::moved>());
+    assert(table.has_handlers<EntityEvent::died>());
+    
+    assert(table.fire<EntityEvent::moved>(1, 2) == 0);
+    assert(table.fire<EntityEvent::damaged>(0.5f) == 1);
+    assert(table.fire<EntityEvent::damaged>(0.25f) == 1);
+    assert(damage == 0.75f);
+    assert(table.fire<EntityEvent::died>() == 1);
+    assert(died);
+    
+    // get gives direct access to the typed Event
+    Event<int, int>& moved = table.get<EntityEvent::moved>();
+    assert(table.find<EntityEvent::moved>() == &moved);
+    assert(table.size() == 3);
+    
+    // events without bound functions are released by compact
+    died_bind = 0;
+    table.compact();
+    assert(table.size() == 1);
+    assert(!table.find<EntityEvent::died>());
+    assert(table.fire<EntityEvent::damaged>(1.0f) == 1);
+    damaged_bind = 0;
+    table.compact();
+    assert(table.size() == 0);
+}
+
+static void test_variant()
+{
+    struct Login { int user; };
+    struct Logout { int user; };
+    struct Ping { };
+    typedef VariantEvent<Login, Logout, Ping> Messages;
+    Messages event;
+    assert(!event.has_handlers<Login>());
+    
+    // a function may subscribe to several types and is shared between them
+    struct Sessions
+    {
+        void operator()(const Login& login) { users.push_back(login.user); }
+        void operator()(const Logout& logout) { users.push_back(-logout.user); }
+        std::vector<int> users;
+    };
+    std::vector<int> pings;
+    // each type may be subscribed to once per bind, bind<Login, Login> does
+    // not compile
+    auto sessions = event.bind<Login, Logout>(Sessions());
+    auto ping = event.bind<Ping>([&](const Ping&){
+        pings.push_back(0);
+    });
+    assert(event.has_handlers<Login>() && event.has_handlers<Ping>());
+    assert(event.fire(Login{1}) == 1);
+    assert(event.fire(Ping()) == 1);
+    Logout logout{1};
+    assert(event.fire(1, &logout) == 1);
+    assert(pings.size() == 1);
+    
+    std::vector<int> users;
+    auto observer = event.bind<Login>([&](const Login& login){
+        users.push_back(login.user);
+    });
+    
+    // unbinding removes the function from every type, also while firing
+    std::shared_ptr<Messages::Bind> once;
+    once = event.bind<Ping>([&](const Ping&){
+        pings.push_back(1);
+        once = 0;
+    });
+    assert(event.fire(Ping()) == 2);
+    assert(event.fire(Ping()) == 1);
+    assert((pings == std::vector<int>{0, 0, 1, 0}));
+    sessions = 0;
+    ping = 0;
+    assert(!event.has_handlers<Ping>());
+    assert(event.fire(Login{2}) == 1);
+    assert(users.back() == 2);
+    
+#if __cplusplus >= 201703L
+    std::variant<Login, Logout, Ping> message = Login{3};
+    assert(event.fire(message) == 1);
+    message = Ping();
+    assert(event.fire(message) == 0);
+#endif
+    
+    // a VariantEvent may be destroyed while firing and Binds may outlive it
+    {
+        std::unique_ptr<Messages> temporary(new Messages());
+        int executed = 0;
+        auto a = temporary->bind<Ping>([&](const Ping&){
+            ++executed;
+            temporary.reset();
+        });
+        auto b = temporary->bind<Ping>([&](const Ping&){
+            ++executed;
+        });
+        assert(temporary->fire(Ping()) == 1);
+        assert(executed == 1);
+    }
+}
+
+static void test_set()
+{
+    enum class Door { opened, closed, locked, count };
+    typedef EventSet<Door, void(int)> Doors;
+    Doors events;
+    assert(!events.has_handlers(Door::opened));
+    assert(events.fire(Door::opened, 0) == 0);
+    
+    // functions only execute for the enumerators they are bound to
+    std::vector<int> executed;
+    auto opened = events.bind(Door::opened, [&](int value){
+        executed.push_back(value);
+    });
+    auto closed = events.bind(Door::closed, [&](int value){
+        executed.push_back(-value);
+    });
+    assert(events.fire(Door::opened, 1) == 1);
+    assert(events.fire(Door::closed, 2) == 1);
+    assert(events.fire(Door::locked, 3) == 0);
+    assert((executed == std::vector<int>{1, -2}));
+    
+    // a function bound to several enumerators at once is shared by them
+    int changes = 0;
+    auto any = events.bind(
+        Doors::keys({Door::opened, Door::closed, Door::locked}),
+        [&](int){
+            ++changes;
+        }
+    );
+    assert(any->bound_keys().count() == 3);
+    assert(events.fire(Door::locked, 0) == 1);
+    assert(events.fire(Door::opened, 0) == 2);
+    any->unbind(Doors::keys({Door::opened, Door::locked}));
+    assert(events.fire(Door::opened, 0) == 1);
+    assert(events.fire(Door::locked, 0) == 0);
+    assert(events.fire(Door::closed, 0) == 2);
+    assert(changes == 3);
+    any = 0;
+    assert(events.fire(Door::closed, 0) == 1);
+    
+    // binding and unbinding while firing take effect on the next firing
+    std::shared_ptr<Doors::Bind> late;
+    std::shared_ptr<Doors::Bind> once;
+    once = events.bind(Door::locked, [&](int){
+        late = events.bind(Door::opened, [&](int value){
+            executed.push_back(value * 100);
+        });
+        once = 0;
+        closed = 0;
+    });
+    assert(events.fire(Door::locked, 0) == 1);
+    assert(!events.has_handlers(Door::locked));
+    assert(!events.has_handlers(Door::closed));
+    executed.clear();
+    assert(events.fire(Door::opened, 1) == 2);
+    assert((executed == std::vector<int>{1, 100}));
+    
+    // an EventSet may be destroyed while firing and Binds may outlive it
+    {
+        std::unique_ptr<Doors> temporary(new Doors());
+        int count = 0;
+        auto a = temporary->bind(Door::opened, [&](int){
+            ++count;
+            temporary.reset();
+        });
+        auto b = temporary->bind(Door::opened, [&](int){
+            ++count;
+        });
+        assert(temporary->fire(Door::opened, 0) == 1);
+        assert(count == 1);
+    }
+}
+
+static void test_route()
+{
+    enum class Side { buy, sell };
+    struct Order
+    {
+        Side side;
+        int quantity;
+        double price;
+    };
+    RoutedEvent<Order> orders;
+    auto side = orders.field(&Order::side);
+    auto quantity = orders.field(&Order::quantity);
+    int projected = 0;
+    auto price = orders.field([&projected](const Order& order){
+        ++projected;
+        return order.price;
+    });
+    assert(!orders.has_handlers());
+    
+    // functions only execute for the messages that pass their filter, in
+    // the order they were bound
+    std::vector<int> executed;
+    auto record = [&executed](int id){
+        return [&executed, id](const Order&){
+            executed.push_back(id);
+        };
+    };
+    auto large_buys = orders.bind(
+        side == Side::buy && quantity > 1000,
+        record(0)
+    );
+    auto buys = orders.bind(side == Side::buy, record(1));
+    auto everything = orders.bind(RoutedEvent<Order>::Filter(), record(2));
+    auto band = orders.bind(price >= 10.0 && price < 20.0, record(3));
+    auto small = orders.bind(quantity <= 10, record(4));
+    auto exact = orders.bind(quantity >= 10 && quantity <= 10, record(5));
+    assert(orders.has_handlers());
+    
+    assert(orders.fire(Order{Side::buy, 2000, 5.0}) == 3);
+    assert((executed == std::vector<int>{0, 1, 2}));
+    executed.clear();
+    assert(orders.fire(Order{Side::buy, 1000, 10.0}) == 3);
+    assert((executed == std::vector<int>{1, 2, 3}));
+    executed.clear();
+    assert(orders.fire(Order{Side::sell, 10, 20.0}) == 3);
+    assert((executed == std::vector<int>{2, 4, 5}));
+    executed.clear();
+    // the projection runs once per firing however many tests use it
+    assert(projected == 3);
+    
+    // unbinding removes the tests, slots are reused by later binds
+    large_buys = 0;
+    everything = 0;
+    assert(orders.fire(Order{Side::buy, 2000, 5.0}) == 1);
+    assert((executed == std::vector<int>{1}));
+    executed.clear();
+    auto sells = orders.bind(side == Side::sell, record(6));
+    assert(orders.fire(Order{Side::sell, 5, 15.0}) == 3);
+    assert((executed == std::vector<int>{3, 4, 6}));
+    executed.clear();
+    
+    // binding and unbinding while firing take effect on the next firing
+    std::shared_ptr<RoutedEvent<Order>::Bind> late;
+    std::shared_ptr<RoutedEvent<Order>::Bind> once;
+    once = orders.bind(quantity == 7, [&](const Order&){
+        late = orders.bind(quantity == 7, record(7));
+        once = 0;
+        sells = 0;
+    });
+    assert(orders.fire(Order{Side::sell, 7, 0.0}) == 3);
+    assert((executed == std::vector<int>{4, 6}));
+    executed.clear();
+    assert(orders.fire(Order{Side::sell, 7, 0.0}) == 2);
+    assert((executed == std::vector<int>{4, 7}));
+    
+    // a RoutedEvent may be destroyed while firing and Binds may outlive it
+    {
+        std::unique_ptr<RoutedEvent<Order>> temporary(
+            new RoutedEvent<Order>()
+        );
+        auto buy = temporary->field(&Order::side) == Side::buy;
+        int count = 0;
+        auto a = temporary->bind(buy, [&](const Order&){
+            ++count;
+            temporary.reset();
+        });
+        auto b = temporary->bind(buy, [&](const Order&){
+            ++count;
+        });
+        assert(temporary->fire(Order{Side::buy, 1, 1.0}) == 1);
+        assert(count == 1);
+    }
+    
+    // fields without std::hash can still be tested, equality tests are kept
+    // in an ordered map instead
+    {
+        struct Release
+        {
+            std::pair<int, int> version;
+        };
+        RoutedEvent<Release> releases;
+        auto version = releases.field(&Release::version);
+        int matched = 0;
+        auto exact = releases.bind(
+            version == std::make_pair(1, 2),
+            [&](const Release&){ ++matched; }
+        );
+        auto newer = releases.bind(
+            version > std::make_pair(1, 0),
+            [&](const Release&){ ++matched; }
+        );
+        assert(releases.fire(Release{{1, 2}}) == 2);
+        assert(releases.fire(Release{{1, 1}}) == 1);
+        assert(releases.fire(Release{{0, 9}}) == 0);
+        assert(matched == 3);
+    }
+}
+
+static void test_graph()
+{
+    GraphEvent<std::vector<std::string>&> event;
+    std::vector<std::string> order;
+    
+    // constraints override the bind order
+    auto present = event.bind("present", [](std::vector<std::string>& order){
+        order.push_back("present");
+    }, GraphOrder().after("render"));
+    auto render = event.bind("render", [](std::vector<std::string>& order){
+        order.push_back("render");
+    }, GraphOrder().after("update"));
+    auto update = event.bind("update", [](std::vector<std::string>& order){
+        order.push_back("update");
+    });
+    auto audio = event.bind("audio", [](std::vector<std::string>& order){
+        order.push_back("audio");
+    }, GraphOrder().before("present"));
+    assert(event.fire(order) == 4);
+    assert(order.size() == 4);
+    auto position = [&](const std::string& tag){
+        return std::find(order.begin(), order.end(), tag) - order.begin();
+    };
+    assert(position("update") < position("render"));
+    assert(position("render") < position("present"));
+    assert(position("audio") < position("present"));
+    
+    // a bind that would create a cycle is rejected and leaves the graph as
+    // it was
+    auto threw = false;
+    try
+    {
+        event.bind("input", [](std::vector<std::string>&){
+        }, GraphOrder().after("present").before("update"));
+    }
+    catch (const std::logic_error&)
+    {
+        threw = true;
+    }
+    assert(threw);
+    order.clear();
+    assert(event.fire(order) == 4);
+    
+    // unbinding keeps the rest ordered
+    render = 0;
+    order.clear();
+    assert(event.fire(order) == 3);
+    assert(position("update") < position("present"));
+    assert(position("audio") < position("present"));
+    
+    // binding while firing takes effect on the next firing, which still
+    // respects the constraints
+    std::shared_ptr<GraphEvent<std::vector<std::string>&>::Bind> late;
+    auto binder = event.bind("binder", [&](std::vector<std::string>&){
+        if (!late)
+        {
+            late = event.bind("late", [](std::vector<std::string>& order){
+                order.push_back("late");
+            }, GraphOrder().before("update"));
+        }
+    });
+    order.clear();
+    assert(event.fire(order) == 4);
+    order.clear();
+    assert(event.fire(order) == 5);
+    assert(position("late") < position("update"));
+    binder = 0;
+    late = 0;
+    
+    // independent functions run in parallel, dependent ones never overlap
+    // with what they depend on
+    EventThreadPool pool(4);
+    GraphEvent<int> parallel;
+    std::atomic<int> stage(0);
+    std::atomic<int> total(0);
+    std::atomic<bool> violated(false);
+    std::vector<std::shared_ptr<GraphEvent<int>::Bind>> binds;
+    for (auto i = 0; i < 8; ++i)
+    {
+        binds.push_back(parallel.bind("work", [&](int value){
+            if (stage != 0)
+            {
+                violated = true;
+            }
+            total += value;
+        }, GraphOrder().before("merge")));
+    }
+    binds.push_back(parallel.bind("merge", [&](int){
+        if (total != 8 * 3)
+        {
+            violated = true;
+        }
+        stage = 1;
+    }));
+    for (auto i = 0; i < 100; ++i)
+    {
+        stage = 0;
+        total = 0;
+        assert(parallel.fire_graph(pool, 3) == 9);
+        assert(!violated);
+        assert(stage == 1);
+    }
+    
+    // the first exception is rethrown once everything has finished
+    binds.push_back(parallel.bind("fail", [](int){
+        throw std::runtime_error("fail");
+    }, GraphOrder().after("merge")));
+    threw = false;
+    try
+    {
+        parallel.fire_graph(pool, 1);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    assert(threw);
+}
+
+static void test_hierarchy()
+{
+    typedef EventHierarchy<std::string&> Hierarchy;
+    Hierarchy hierarchy;
+    Hierarchy::Node root(hierarchy);
+    Hierarchy::Node middle(hierarchy, &root);
+    Hierarchy::Node leaf(hierarchy, &middle);
+    std::string trace;
+    auto record = [](const char* name){
+        return [name](Hierarchy::Dispatch& dispatch, std::string& trace){
+            trace += name;
+            trace += dispatch.phase() == EventPhase::capture ? "c" :
+                dispatch.phase() == EventPhase::target ? "t" : "b";
+        };
+    };
+    
+    // capture runs from the root down, bubbling from the target up
+    auto root_capture = root.bind_capture(record("R"));
+    auto root_bubble = root.bind(record("R"));
+    auto middle_bubble = middle.bind(record("M"));
+    auto leaf_bubble = leaf.bind(record("L"));
+    auto leaf_capture = leaf.bind_capture(record("l"));
+    assert(hierarchy.fire_bubbling(leaf, trace) == 5);
+    assert(trace == "RcltLtMbRb");
+    trace.clear();
+    assert(hierarchy.fire_bubbling(middle, trace) == 3);
+    assert(trace == "RcMtRb");
+    
+    // stop_propagation finishes the current node, stop_immediate_propagation
+    // stops right away
+    auto middle_stop = middle.bind(
+        [](Hierarchy::Dispatch& dispatch, std::string&){
+            dispatch.stop_propagation();
+        }
+    );
+    auto middle_after = middle.bind(record("m"));
+    trace.clear();
+    assert(hierarchy.fire_bubbling(leaf, trace) == 6);
+    assert(trace == "RcltLtMbmb");
+    auto leaf_stop = leaf.bind_capture(
+        [](Hierarchy::Dispatch& dispatch, std::string&){
+            assert(&dispatch.target() == &dispatch.current());
+            dispatch.stop_immediate_propagation();
+        }
+    );
+    trace.clear();
+    assert(hierarchy.fire_bubbling(leaf, trace) == 3);
+    assert(trace == "Rclt");
+    leaf_stop = 0;
+    middle_stop = 0;
+    
+    // unbinding during a firing skips the function, changes to the tree
+    // are picked up by the next firing
+    auto unbind_middle = leaf.bind([&](Hierarchy::Dispatch&, std::string&){
+        middle_bubble = 0;
+    });
+    trace.clear();
+    assert(hierarchy.fire_bubbling(leaf, trace) == 6);
+    assert(trace == "RcltLtmbRb");
+    leaf.set_parent(&root);
+    trace.clear();
+    assert(hierarchy.fire_bubbling(leaf, trace) == 5);
+    assert(trace == "RcltLtRb");
+    
+    // destroying a node unbinds its functions and orphans its children
+    {
+        Hierarchy::Node other(hierarchy, &leaf);
+        auto bind = other.bind(record("O"));
+        Hierarchy::Node child(hierarchy, &other);
+        trace.clear();
+        hierarchy.fire_bubbling(child, trace);
+        assert(trace == "RclcObLbRb");
+        {
+            Hierarchy::Node temporary(hierarchy, &child);
+        }
+        leaf.set_parent(0);
+        trace.clear();
+        hierarchy.fire_bubbling(child, trace);
+        assert(trace == "lcObLb");
+    }
+    
+    // a bind only changes the firings of its node and the node's
+    // descendants, a bind to an ancestor reaches all of them
+    {
+        Hierarchy::Node left(hierarchy, &root);
+        Hierarchy::Node right(hierarchy, &root);
+        Hierarchy::Node below(hierarchy, &left);
+        trace.clear();
+        hierarchy.fire_bubbling(right, trace);
+        hierarchy.fire_bubbling(below, trace);
+        assert(trace == "RcRbRcRb");
+        auto left_bind = left.bind(record("A"));
+        trace.clear();
+        hierarchy.fire_bubbling(right, trace);
+        hierarchy.fire_bubbling(below, trace);
+        assert(trace == "RcRbRcAbRb");
+        auto root_after = root.bind(record("Z"));
+        trace.clear();
+        hierarchy.fire_bubbling(right, trace);
+        hierarchy.fire_bubbling(below, trace);
+        assert(trace == "RcRbZbRcAbRbZb");
+    }
+    
+    // a deep tree fires through all ancestors
+    std::vector<std::unique_ptr<Hierarchy::Node>> chain;
+    std::vector<std::shared_ptr<Hierarchy::Bind>> binds;
+    chain.emplace_back(new Hierarchy::Node(hierarchy));
+    for (auto i = 0; i < 64; ++i)
+    {
+        chain.emplace_back(new Hierarchy::Node(hierarchy, chain.back().get()));
+        binds.push_back(chain.back()->bind(record("")));
+    }
+    for (auto i = 0; i < 3; ++i)
+    {
+        trace.clear();
+        assert(hierarchy.fire_bubbling(*chain.back(), trace) == 64);
+    }
+}
+
+static void test_realtime()
+{
+    RealtimeEvent<int> event;
+    assert(event.is_lock_free());
+    assert(!event.has_handlers());
+    assert(event.fire(1) == 0);
+    
+    std::atomic<int> total(0);
+    auto bind = event.bind([&total](int value){
+        total += value;
+    });
+    assert(event.has_handlers());
+    assert(event.fire(2) == 1);
+    assert(total == 2);
+    bind = 0;
+    assert(event.fire(2) == 0);
+    
+    // a realtime thread fires while this thread binds and unbinds, firing
+    // must not allocate and unbound functions must never execute again
+    std::atomic<bool> running(true);
+    std::atomic<std::size_t> fires(0);
+    std::thread realtime([&]{
+        realtime_thread = true;
+        while (running)
+        {
+            event.fire(1);
+            ++fires;
+        }
+        realtime_thread = false;
+    });
+    auto permanent = event.bind([&total](int value){
+        total += value;
+    });
+    for (auto i = 0; i < 200; ++i)
+    {
+        auto unbound = std::make_shared<std::atomic<bool>>(false);
+        auto temporary = event.bind([unbound](int){
+            assert(!*unbound);
+        });
+        std::this_thread::yield();
+        temporary = 0;
+        *unbound = true;
+    }
+    while (fires < 1000)
+    {
+        std::this_thread::yield();
+    }
+    running = false;
+    realtime.join();
+    assert(realtime_allocations == 0);
+    assert(total > 2);
+}
+
+static void test_sharded()
+{
+    ShardedEvent<int> event(4);
+    assert(event.shard_count() == 4);
+    assert(event.fire(1) == 0);
+    std::atomic<int> total(0);
+    auto bind = event.bind([&total](int value){
+        total += value;
+    });
+    assert(event.fire(2) == 1);
+    assert(total == 2);
+    
+    // threads bind to their own shards, firing reaches all of them
+    std::vector<std::shared_ptr<ShardedEvent<int>::Bind>> binds(8);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < binds.size(); ++i)
+    {
+        threads.emplace_back([&, i]{
+            for (auto j = 0; j < 100; ++j)
+            {
+                binds[i] = 0;
+                binds[i] = event.bind([&total](int value){
+                    total += value;
+                });
+                event.fire(0);
+            }
+        });
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    total = 0;
+    assert(event.fire(1) == 9);
+    assert(total == 9);
+    
+    // unbinding while firing skips the function
+    std::shared_ptr<ShardedEvent<int>::Bind> later;
+    auto unbinder = event.bind([&later](int){
+        later = 0;
+    });
+    later = event.bind([](int){
+        assert(false);
+    });
+    binds.clear();
+    bind = 0;
+    assert(event.fire(1) == 1);
+}
+
+static void test_thread_local()
+{
+    ThreadLocalEvent<const std::string&> event;
+    assert(event.fire_local("none") == 0);
+    assert(event.deliver() == 0);
+    
+    std::vector<std::string> received;
+    auto bind = event.bind_thread_local([&](const std::string& value){
+        received.push_back(value);
+    });
+    assert(event.fire_local("main") == 1);
+    assert(received.size() == 1);
+    
+    // functions bound on another thread only execute there
+    std::atomic<int> stage(0);
+    std::atomic<int> other_received(0);
+    std::atomic<std::size_t> other_local(99);
+    std::thread other([&]{
+        auto other_bind = event.bind_thread_local([&](const std::string&){
+            ++other_received;
+        });
+        stage = 1;
+        while (stage != 2)
+        {
+            std::this_thread::yield();
+        }
+        other_local = event.fire_local("other");
+        assert(event.deliver() == 2);
+        stage = 3;
+    });
+    while (stage != 1)
+    {
+        std::this_thread::yield();
+    }
+    assert(event.fire_local("main") == 1);
+    assert(received.size() == 2);
+    assert(other_received == 0);
+    // broadcasts wait in each thread's mailbox until delivered
+    assert(event.fire_all("all 1") == 2);
+    assert(event.fire_all(std::string("all 2")) == 2);
+    assert(received.size() == 2);
+    stage = 2;
+    other.join();
+    assert(other_local == 1);
+    assert(other_received == 3);
+    assert(event.deliver() == 2);
+    assert(received.size() == 4);
+    assert(received[2] == "all 1" && received[3] == "all 2");
+    // the exited thread is no longer mailed
+    assert(event.fire_all("all 3") == 1);
+    
+    // binding and unbinding while firing
+    std::shared_ptr<ThreadLocalEvent<const std::string&>::Bind> added;
+    std::shared_ptr<ThreadLocalEvent<const std::string&>::Bind> removed;
+    auto changer = event.bind_thread_local([&](const std::string&){
+        if (!added)
+        {
+            added = event.bind_thread_local([](const std::string&){
+            });
+        }
+        removed = 0;
+    });
+    removed = event.bind_thread_local([](const std::string&){
+        assert(false);
+    });
+    received.clear();
+    assert(event.fire_local("change") == 2);
+    assert(event.fire_local("change") == 3);
+    assert(event.deliver() == 1);
+    
+    // once a thread's last Bind is gone it is no longer mailed, and its
+    // mailbox is freed
+    {
+        ThreadLocalEvent<std::shared_ptr<int>> tokens;
+        auto token = std::make_shared<int>(0);
+        auto token_bind = tokens.bind_thread_local([](std::shared_ptr<int>){
+        });
+        assert(tokens.fire_all(token) == 1);
+        assert(token.use_count() == 2);
+        token_bind = 0;
+        assert(token.use_count() == 1);
+        assert(tokens.fire_all(token) == 0);
+        assert(tokens.deliver() == 0);
+        assert(token.use_count() == 1);
+    }
+    
+    // the Locals of a destroyed event are freed with their last Bind
+    {
+        auto token = std::make_shared<int>(0);
+        std::shared_ptr<ThreadLocalEvent<std::shared_ptr<int>>::Bind> kept;
+        {
+            ThreadLocalEvent<std::shared_ptr<int>> tokens;
+            kept = tokens.bind_thread_local([](std::shared_ptr<int>){
+            });
+            tokens.fire_all(token);
+        }
+        assert(token.use_count() == 2);
+        kept = 0;
+        assert(token.use_count() == 1);
+    }
+    
+    // destroying the last Bind while firing
+    {
+        ThreadLocalEvent<> local_event;
+        std::shared_ptr<ThreadLocalEvent<>::Bind> self;
+        self = local_event.bind_thread_local([&]{
+            self = 0;
+        });
+        local_event.fire_all();
+        local_event.fire_all();
+        assert(local_event.deliver() == 2);
+        assert(local_event.fire_local() == 0);
+        assert(local_event.fire_all() == 0);
+    }
+}
+
+static void test_concurrent()
+{
+    ConcurrentEvent<int> event;
+    assert(event.fire(1) == 0);
+    
+    // destroying a Bind waits for the function to return on other threads
+    std::atomic<bool> alive(true);
+    std::atomic<bool> entered(false);
+    auto bind = event.bind([&](int){
+        entered = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        assert(alive);
+    });
+    std::thread firing([&]{
+        event.fire(1);
+    });
+    while (!entered)
+    {
+        std::this_thread::yield();
+    }
+    bind = 0;
+    alive = false;
+    firing.join();
+    assert(event.fire(1) == 0);
+    
+    // a function may destroy its own Bind without waiting for itself
+    std::shared_ptr<ConcurrentEvent<int>::Bind> self;
+    self = event.bind([&self](int){
+        self = 0;
+    });
+    assert(event.fire(1) == 1);
+    assert(event.fire(1) == 0);
+    
+    // binding, unbinding and firing from many threads at once
+    std::atomic<bool> running(true);
+    std::atomic<int> total(0);
+    auto permanent = event.bind([&total](int value){
+        total += value;
+    });
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&]{
+            while (running)
+            {
+                event.fire(1);
+            }
+        });
+    }
+    for (auto i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&]{
+            for (auto j = 0; j < 200; ++j)
+            {
+                auto object = std::make_shared<std::atomic<bool>>(true);
+                auto bind = event.bind([object](int){
+                    assert(*object);
+                });
+                std::this_thread::yield();
+                bind = 0;
+                *object = false;
+            }
+        });
+    }
+    for (std::size_t i = 4; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    running = false;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        threads[i].join();
+    }
+    assert(total > 0);
+    assert(event.fire(0) == 1);
+}
+
+static void test_fiber()
+{
+    EventFiberScheduler scheduler;
+    Event<int> event;
+    std::vector<std::string> trace;
+    
+    // a fiber that waits part way does not hold up the firing
+    EventFiberScheduler::Fiber* waiting = 0;
+    auto waiter = scheduler.bind_fiber(event, [&](int value){
+        trace.push_back("wait " + std::to_string(value));
+        waiting = EventFiberScheduler::current();
+        EventFiberScheduler::suspend();
+        trace.push_back("woken " + std::to_string(value));
+    });
+    auto plain = event.bind([&](int){
+        trace.push_back("plain");
+    });
+    assert(event.fire(1) == 2);
+    assert(trace.size() == 2);
+    assert(trace[0] == "wait 1" && trace[1] == "plain");
+    assert(scheduler.run() == 1);
+    assert(trace.size() == 2);
+    scheduler.wake(*waiting);
+    assert(scheduler.run() == 0);
+    assert(trace.size() == 3 && trace[2] == "woken 1");
+    waiter = 0;
+    plain = 0;
+    
+    // yielding fibers take turns
+    trace.clear();
+    for (auto name: {"a", "b"})
+    {
+        scheduler.spawn([&trace, name]{
+            for (auto i = 0; i < 2; ++i)
+            {
+                trace.push_back(name);
+                EventFiberScheduler::yield();
+            }
+        });
+    }
+    assert(!EventFiberScheduler::current());
+    assert(scheduler.run() == 0);
+    assert(trace.size() == 4);
+    assert(trace[0] == "a" && trace[1] == "b");
+    assert(trace[2] == "a" && trace[3] == "b");
+    
+    // stacks are reused, and exceptions reach whoever resumed the fiber
+    for (auto i = 0; i < 1000; ++i)
+    {
+        scheduler.spawn([]{
+            EventFiberScheduler::yield();
+        });
+        scheduler.run();
+    }
+    scheduler.spawn([]{
+        EventFiberScheduler::yield();
+        throw std::runtime_error("fiber");
+    });
+    auto threw = false;
+    try
+    {
+        scheduler.run();
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    assert(threw);
+}
+
+namespace
+{
+    /*
+        Records how a sender completed.
+    */
+    struct Completion
+    {
+        Completion():
+            values(0),
+            last(0),
+            errors(0),
+            stops(0)
+        {
+        }
+        
+        int values;
+        
+        int last;
+        
+        int errors;
+        
+        int stops;
+    };
+    
+    struct RecordingReceiver
+    {
+        void set_value(int value)
+        {
+            ++this->completion->values;
+            this->completion->last = value;
+        }
+        
+        void set_value()
+        {
+            ++this->completion->values;
+        }
+        
+        void set_error(std::exception_ptr)
+        {
+            ++this->completion->errors;
+        }
+        
+        void set_stopped()
+        {
+            ++this->completion->stops;
+        }
+        
+        Completion* completion;
+    };
+}
+
+static void test_sender()
+{
+    Event<int> event;
+    Completion completion;
+    
+    // an operation completes with the next firing only
+    {
+        auto operation = event.as_sender().connect(
+            RecordingReceiver{&completion}
+        );
+        assert(!event.has_handlers());
+        operation.start();
+        assert(operation.is_waiting());
+        assert(event.has_handlers());
+        assert(event.fire(5) == 1);
+        assert(!operation.is_waiting());
+        assert(event.fire(6) == 0);
+        assert(completion.values == 1 && completion.last == 5);
+    }
+    
+    // bind_receiver starts straight away, operations complete in the order
+    // they started and alongside bound functions
+    {
+        Completion first;
+        Completion second;
+        std::vector<int> order;
+        auto bind = event.bind([&](int){
+            order.push_back(0);
+        });
+        auto a = event.bind_receiver(RecordingReceiver{&first});
+        auto b = event.bind_receiver(RecordingReceiver{&second});
+        // moving a waiting operation keeps it waiting
+        auto moved = std::move(a);
+        assert(moved.is_waiting() && !a.is_waiting());
+        assert(event.fire(7) == 3);
+        assert(first.values == 1 && second.values == 1);
+        assert(first.last == 7);
+    }
+    
+    // destroying an operation cancels it, destroying the Event stops it
+    {
+        Completion cancelled;
+        {
+            auto operation = event.bind_receiver(RecordingReceiver{&cancelled});
+        }
+        assert(event.fire(1) == 0);
+        assert(cancelled.values == 0 && cancelled.stops == 0);
+        
+        Completion stopped;
+        std::unique_ptr<Event<int>> temporary(new Event<int>());
+        auto operation = temporary->bind_receiver(
+            RecordingReceiver{&stopped}
+        );
+        temporary.reset();
+        assert(stopped.stops == 1);
+        assert(!operation.is_waiting());
+    }
+    
+    // then transforms the values, exceptions become errors
+    {
+        Completion transformed;
+        auto operation = then(event.as_sender(), [](int value){
+            return value * 2;
+        }).connect(RecordingReceiver{&transformed});
+        operation.start();
+        event.fire(21);
+        assert(transformed.last == 42);
+        
+        Completion failed;
+        auto failing = then(event.as_sender(), [](int) -> int {
+            throw std::runtime_error("then");
+        }).connect(RecordingReceiver{&failed});
+        failing.start();
+        Completion ignored;
+        auto ignoring = then(event.as_sender(), [](int){
+        }).connect(RecordingReceiver{&ignored});
+        ignoring.start();
+        event.fire(1);
+        assert(failed.errors == 1 && failed.values == 0);
+        assert(ignored.values == 1);
+    }
+    
+    // when_all completes once every sender has, with all of their values,
+    // errors take precedence over stops
+    {
+        Event<> ready;
+        Completion combined;
+        auto operation = when_all(
+            event.as_sender(),
+            ready.as_sender()
+        ).connect(RecordingReceiver{&combined});
+        operation.start();
+        event.fire(3);
+        assert(combined.values == 0);
+        ready.fire();
+        assert(combined.values == 1 && combined.last == 3);
+        
+        Completion failed;
+        std::unique_ptr<Event<>> temporary(new Event<>());
+        auto failing = when_all(
+            temporary->as_sender(),
+            then(event.as_sender(), [](int) -> int {
+                throw std::runtime_error("when_all");
+            })
+        ).connect(RecordingReceiver{&failed});
+        failing.start();
+        Completion stopped;
+        auto stopping = when_all(
+            temporary->as_sender(),
+            then(event.as_sender(), [](int){
+            })
+        ).connect(RecordingReceiver{&stopped});
+        stopping.start();
+        event.fire(1);
+        assert(failed.errors == 0 && stopped.stops == 0);
+        temporary.reset();
+        assert(failed.errors == 1 && failed.stops == 0);
+        assert(stopped.stops == 1 && stopped.values == 0);
+    }
+    
+    // schedule_on completes the receiver on the scheduler
+    {
+        struct ThreadReceiver
+        {
+            void set_value(int value)
+            {
+                *this->value = value;
+                *this->thread = std::this_thread::get_id();
+            }
+            
+            void set_error(std::exception_ptr)
+            {
+            }
+            
+            void set_stopped()
+            {
+            }
+            
+            int* value;
+            
+            std::thread::id* thread;
+        };
+        int value = 0;
+        std::thread::id thread;
+        {
+            EventThreadPool pool(1);
+            auto operation = schedule_on(
+                pool,
+                event.as_sender()
+            ).connect(ThreadReceiver{&value, &thread});
+            operation.start();
+            event.fire(9);
+        }
+        assert(value == 9);
+        assert(thread != std::thread::id());
+        assert(thread != std::this_thread::get_id());
+    }
+}
+
+static void test_future()
+{
+    Event<int, const std::string&> event;
+    
+    // a future is ready with the arguments of the next firing only
+    {
+        auto future = event.next_future();
+        assert(event.has_handlers());
+        assert(future.status() == EventFutureStatus::timeout);
+        assert(event.fire(1, "one") == 1);
+        assert(!event.has_handlers());
+        assert(future.status() == EventFutureStatus::ready);
+        assert(std::get<0>(future.get()) == 1);
+        assert(std::get<1>(future.get()) == "one");
+        event.fire(2, "two");
+        assert(std::get<0>(future.get()) == 1);
+    }
+    
+    // waiting times out while the Event does not fire
+    {
+        auto future = event.next_future();
+        auto status = future.wait_for(std::chrono::milliseconds(5));
+        assert(status == EventFutureStatus::timeout);
+    }
+    // an abandoned future is not a handler and is dropped
+    assert(!event.has_handlers());
+    assert(event.fire(0, "") == 0);
+    
+    // futures that keep timing out on a quiet Event do not pile up
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            auto future = event.next_future();
+            auto status = future.wait_for(std::chrono::milliseconds(1));
+            assert(status == EventFutureStatus::timeout);
+        }
+        auto lazy = false;
+        event.fire_lazy([&]{
+            lazy = true;
+            return std::make_tuple(0, std::string());
+        });
+        assert(!lazy);
+        
+        // a future dropped behind one still waiting is skipped by the firing
+        typedef EventFuture<int, const std::string&> Future;
+        std::unique_ptr<Future> dropped(new Future(event.next_future()));
+        auto kept = event.next_future();
+        dropped.reset();
+        assert(event.has_handlers());
+        assert(event.fire(5, "five") == 1);
+        assert(std::get<0>(kept.get()) == 5);
+        assert(!event.has_handlers());
+    }
+    
+    // another thread blocks until the Event fires
+    {
+        auto future = event.next_future();
+        std::atomic<int> value(0);
+        std::thread waiter([&]{
+            auto status = future.wait_for(std::chrono::seconds(10));
+            assert(status == EventFutureStatus::ready);
+            value = std::get<0>(future.get());
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        event.fire(3, "three");
+        waiter.join();
+        assert(value == 3);
+    }
+    
+    // many threads wait on their own futures of the same firing
+    {
+        std::vector<EventFuture<int, const std::string&>> futures;
+        for (int i = 0; i < 1000; ++i)
+        {
+            futures.push_back(event.next_future());
+        }
+        std::atomic<int> sum(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([&, i]{
+                for (std::size_t j = i; j < futures.size(); j += 8)
+                {
+                    sum += std::get<0>(futures[j].get());
+                }
+            });
+        }
+        assert(event.fire(4, "four") == 1000);
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+        assert(sum == 4000);
+    }
+    
+    // destroying the Event stops the futures
+    {
+        std::unique_ptr<Event<int, const std::string&>> temporary(
+            new Event<int, const std::string&>()
+        );
+        auto future = temporary->next_future();
+        temporary.reset();
+        assert(future.wait() == EventFutureStatus::stopped);
+        bool thrown = false;
+        try
+        {
+            future.get();
+        }
+        catch (const std::logic_error&)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+}